@@ -22,6 +22,23 @@
 #define UNLIKELY(pred) (pred)
 #endif
 
+/*
+ * vectorized fast paths for ASCII runs in UTF-8b conversions.
+ * SSE2 and NEON are part of the baseline x86_64 and aarch64 instruction sets,
+ * thus no runtime detection is needed. Other CPUs use 64-bit word-at-a-time checks.
+ * Define SCHEMESH_NO_SIMD to use only the scalar loops.
+ */
+#if defined(SCHEMESH_NO_SIMD)
+#undef SCHEMESH_SIMD_SSE2
+#undef SCHEMESH_SIMD_NEON
+#elif defined(__SSE2__)
+#define SCHEMESH_SIMD_SSE2
+#include <emmintrin.h> /* _mm_loadu_si128(), _mm_movemask_epi8() */
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define SCHEMESH_SIMD_NEON
+#include <arm_neon.h> /* vld1q_u8(), vmaxvq_u8() */
+#endif
+
 typedef struct {
   uint32_t codepoint;
   uint32_t length;
@@ -32,26 +49,87 @@ typedef struct {
   size_t char_n;
 } sizepair;
 
-static size_t c_fnv1a(const octet data[], const size_t n) {
-#if SIZE_MAX <= 0xFFFFFFFFu
-  const size_t prime = 0x01000193u;
-  size_t       hash  = 0x811c9dc5u;
+/*
+ * word-at-a-time hash, in the style of wyhash:
+ * consumes 16 bytes per iteration and mixes them with a 64x64 -> 128 bit multiplication,
+ * folding the upper half into the lower half.
+ *
+ * The seed allows callers to randomize the hash against hash flooding,
+ * for example from untrusted filenames.
+ * Hash values depend on CPU endianness: they must not be stored or sent to other hosts.
+ */
+static const uint64_t hash_k0 = 0xa0761d6478bd642full;
+static const uint64_t hash_k1 = 0xe7037ed1a0b428dbull;
+static const uint64_t hash_k2 = 0x8ebc6af09c88c6e3ull;
+
+static uint64_t c_hash_mum(const uint64_t a, const uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+  const __uint128_t r = (__uint128_t)a * b;
+  return (uint64_t)r ^ (uint64_t)(r >> 64);
 #else
-  const size_t prime = 0x00000100000001b3ul;
-  size_t       hash  = 0xcbf29ce484222325ul;
+  const uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+  const uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+  const uint64_t lo = a_lo * b_lo, mid1 = a_lo * b_hi, mid2 = a_hi * b_lo, hi = a_hi * b_hi;
+  const uint64_t mid = (lo >> 32) + (uint32_t)mid1 + (uint32_t)mid2;
+  return ((mid << 32) | (uint32_t)lo) ^ (hi + (mid1 >> 32) + (mid2 >> 32) + (mid >> 32));
 #endif
-  size_t i;
+}
 
-  for (i = 0; i < n; i++) {
-    hash ^= (unsigned char)data[i];
-    hash *= prime;
+static uint64_t c_hash_read64(const octet* data) {
+  uint64_t ret;
+  memcpy(&ret, data, 8);
+  return ret;
+}
+
+/** hash n bytes starting at data[] */
+static uint64_t c_hash_bytes(const octet data[], size_t n, const uint64_t seed) {
+  const size_t len = n;
+  uint64_t     h   = seed ^ hash_k0;
+  uint64_t     tail;
+  for (; n >= 16; data += 16, n -= 16) {
+    h = c_hash_mum(c_hash_read64(data) ^ hash_k1, c_hash_read64(data + 8) ^ h);
+  }
+  if (n >= 8) {
+    h = c_hash_mum(c_hash_read64(data) ^ hash_k1, h ^ hash_k2);
+    data += 8;
+    n -= 8;
   }
-  return hash;
+  tail = 0;
+  memcpy(&tail, data, n);
+  h = c_hash_mum(tail ^ hash_k1, h ^ hash_k2);
+  return c_hash_mum(h ^ hash_k0, (uint64_t)len ^ hash_k1);
 }
 
-static ptr c_fnv1a_unsigned_fixnum(const octet data[], const size_t n) {
-  const size_t hash = c_fnv1a(data, n);
+/**
+ * hash Scheme string characters in the range [start, end),
+ * working directly on their Unicode codepoints: no conversion to UTF-8b.
+ * Consumes four characters per round, packing two 32-bit codepoints in each 64-bit word.
+ * The last (up to three) characters are packed 21 bits each in a single 64-bit word.
+ */
+static uint64_t c_hash_string(ptr str, iptr start, const iptr end, const uint64_t seed) {
+  const uint64_t len = (uint64_t)(end - start);
+  uint64_t       h   = seed ^ hash_k0;
+  uint64_t       tail;
+  for (; start + 4 <= end; start += 4) {
+    const uint64_t a = Sstring_ref(str, start) | (uint64_t)Sstring_ref(str, start + 1) << 32;
+    const uint64_t b = Sstring_ref(str, start + 2) | (uint64_t)Sstring_ref(str, start + 3) << 32;
+    h                = c_hash_mum(a ^ hash_k1, b ^ h);
+  }
+  tail = 0;
+  for (; start < end; start++) {
+    tail = (tail << 21) | Sstring_ref(str, start);
+  }
+  h = c_hash_mum(tail ^ hash_k1, h ^ hash_k2);
+  return c_hash_mum(h ^ hash_k0, len ^ hash_k1);
+}
 
+/** convert a hash value to a non-negative Scheme fixnum */
+static ptr c_hash_to_unsigned_fixnum(const uint64_t hash64) {
+#if SIZE_MAX <= 0xFFFFFFFFu
+  const size_t hash = (size_t)(hash64 ^ (hash64 >> 32));
+#else
+  const size_t hash = (size_t)hash64;
+#endif
   /* Sfixnum(n) multiplies n by X (usually 8), then uses top bit as sign */
   ptr fxhash = Sfixnum(hash);
   if (Sfixnum_value(fxhash) < 0) {
@@ -87,13 +165,56 @@ static void c_subbytevector_fill(ptr bvec, iptr start, iptr end, int value) {
   }
 }
 
-/** @return hash of a bytevector  */
-static ptr c_bytevector_hash(ptr bvec) {
+/**
+ * fill with 32-bit value a range of 32-bit elements inside a bytevector.
+ * used by screen/vcellvector.ss, where each cell is a 32-bit native-endian integer
+ */
+static void c_vcellvector_fill(ptr bvec, iptr start, iptr end, int32_t value) {
+  if (Sbytevectorp(bvec) && 0 <= start && start < end && end <= Sbytevector_length(bvec) / 4) {
+    int32_t* data = (int32_t*)Sbytevector_data(bvec);
+    iptr     i;
+    for (i = start; i < end; i++) {
+      data[i] = value;
+    }
+  }
+}
+
+/**
+ * copy n characters from string range [src_start, src_start + n)
+ * into a bytevector range of 32-bit elements [dst_start, dst_start + n),
+ * storing each character as a cell with palette 0 i.e. as its codepoint.
+ * used by screen/vcellvector.ss
+ */
+static void c_vcellvector_copy_string(ptr str, iptr src_start, ptr bvec, iptr dst_start, iptr n) {
+  if (Sstringp(str) && Sbytevectorp(bvec) && n > 0 && 0 <= src_start &&
+      src_start <= Sstring_length(str) - n && 0 <= dst_start &&
+      dst_start <= Sbytevector_length(bvec) / 4 - n) {
+    int32_t* data = (int32_t*)Sbytevector_data(bvec) + dst_start;
+    iptr     i;
+    for (i = 0; i < n; i++) {
+      data[i] = (int32_t)Sstring_ref(str, src_start + i);
+    }
+  }
+}
+
+/** @return hash of a bytevector, computed with specified seed */
+static ptr c_bytevector_hash(ptr bvec, uint64_t seed) {
 #if 0 /* redundant, already checked by Scheme function (bytevector-hash) */
   if (Sbytevectorp(bvec))
 #endif
   {
-    return c_fnv1a_unsigned_fixnum(Sbytevector_data(bvec), Sbytevector_length(bvec));
+    return c_hash_to_unsigned_fixnum(
+        c_hash_bytes(Sbytevector_data(bvec), (size_t)Sbytevector_length(bvec), seed));
+  }
+}
+
+/** @return hash of a string, computed with specified seed */
+static ptr c_string_hash(ptr str, uint64_t seed) {
+#if 0 /* redundant, already checked by Scheme function (string-hash*) */
+  if (Sstringp(str))
+#endif
+  {
+    return c_hash_to_unsigned_fixnum(c_hash_string(str, 0, Sstring_length(str), seed));
   }
 }
 
@@ -113,6 +234,66 @@ static ptr c_bytevector_index_u8(ptr bvec, iptr start, iptr end, int value) {
   return Sfalse;
 }
 
+/**
+ * find all bytes equal to value in bytevector range [start, end),
+ * and return a bytevector containing their positions as native-endian int64,
+ * each relative to the start of bvec.
+ * return #f if arguments are invalid.
+ */
+static ptr c_bytevector_index_all_u8(ptr bvec, iptr start, iptr end, int value) {
+  if (Sbytevectorp(bvec) && 0 <= start && start <= end && end <= Sbytevector_length(bvec)) {
+    const octet* data = Sbytevector_data(bvec);
+    const octet* pos  = data + start;
+    const octet* stop = data + end;
+    octet*       out;
+    ptr          ret;
+    iptr         count = 0;
+    value &= 0xFF;
+    while (pos < stop && (pos = (const octet*)memchr(pos, value, (size_t)(stop - pos))) != NULL) {
+      count++, pos++;
+    }
+    ret = Smake_bytevector(count * (iptr)sizeof(int64_t), 0);
+    out = Sbytevector_data(ret);
+    for (pos = data + start; count-- > 0; pos++, out += sizeof(int64_t)) {
+      int64_t offset;
+      pos    = (const octet*)memchr(pos, value, (size_t)(stop - pos));
+      offset = (int64_t)(pos - data);
+      memcpy(out, &offset, sizeof(int64_t)); /* out may be unaligned */
+    }
+    return ret;
+  }
+  return Sfalse;
+}
+
+/**
+ * find all characters equal to codepoint ch in string range [start, end),
+ * and return a bytevector containing their positions as native-endian int64,
+ * each relative to the start of str.
+ * return #f if arguments are invalid.
+ */
+static ptr c_string_index_all_char(ptr str, iptr start, iptr end, int ch) {
+  if (Sstringp(str) && 0 <= start && start <= end && end <= Sstring_length(str)) {
+    octet* out;
+    ptr    ret;
+    iptr   i, count = 0;
+    for (i = start; i < end; i++) {
+      count += (int)Sstring_ref(str, i) == ch;
+    }
+    ret = Smake_bytevector(count * (iptr)sizeof(int64_t), 0);
+    out = Sbytevector_data(ret);
+    for (i = start; count > 0; i++) {
+      if ((int)Sstring_ref(str, i) == ch) {
+        int64_t offset = (int64_t)i;
+        memcpy(out, &offset, sizeof(int64_t)); /* out may be unaligned */
+        out += sizeof(int64_t);
+        count--;
+      }
+    }
+    return ret;
+  }
+  return Sfalse;
+}
+
 /**
  * INTENTIONALLY fills string with Unicode codepoints in the surrogate range 0xDC80..0xDCFF,
  * which cannot be created with (integer->char).
@@ -133,6 +314,43 @@ static ptr c_string_fill_utf8b_surrogate_chars(const ptr string) {
   return string;
 }
 
+/**
+ * return the number of initial bytes in[0 ... in_len) that are ASCII, i.e. < 0x80.
+ * Such bytes are converted by UTF-8b to the identical codepoint, one byte per codepoint.
+ */
+static size_t c_ascii_prefix_length(const octet* in, const size_t in_len) {
+  size_t i = 0;
+#if !defined(SCHEMESH_NO_SIMD)
+#if defined(SCHEMESH_SIMD_SSE2)
+  for (; i + 16 <= in_len; i += 16) {
+    if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(in + i))) != 0) {
+      break;
+    }
+  }
+#elif defined(SCHEMESH_SIMD_NEON)
+  for (; i + 16 <= in_len; i += 16) {
+    if (vmaxvq_u8(vld1q_u8(in + i)) >= 0x80) {
+      break;
+    }
+  }
+#endif
+  for (; i + 8 <= in_len; i += 8) {
+    uint64_t word;
+    memcpy(&word, in + i, 8);
+    if (word & 0x8080808080808080ull) {
+      break;
+    }
+  }
+  while (i < in_len && in[i] < 0x80) {
+    i++;
+  }
+#else
+  (void)in;
+  (void)in_len;
+#endif /* SCHEMESH_NO_SIMD */
+  return i;
+}
+
 /**
  * convert UTF-32 codepoint to UTF-8b sequence, and return length of such sequence.
  * Does not actually create an UTF-8b sequence - only pretends to.
@@ -242,7 +460,19 @@ static ptr c_string_to_utf8b_append(ptr string, iptr start, iptr end, ptr bvec,
       if (UNLIKELY(opos >= oend)) {
         return Sfalse;
       }
-      const unsigned codepoint = Sstring_ref(string, ipos);
+      unsigned codepoint = Sstring_ref(string, ipos);
+#if !defined(SCHEMESH_NO_SIMD)
+      /* fast path: copy a run of ASCII characters without calling c_codepoint_to_utf8b() */
+      while (codepoint < 0x80) {
+        out[opos++] = (octet)codepoint;
+        if (++ipos >= iend) {
+          return Sfixnum(opos);
+        } else if (UNLIKELY(opos >= oend)) {
+          return Sfalse;
+        }
+        codepoint = Sstring_ref(string, ipos);
+      }
+#endif
       const uptr     written   = c_codepoint_to_utf8b(codepoint, out + opos, oend - opos);
       if (LIKELY(written != 0)) {
         opos += written;
@@ -417,6 +647,15 @@ static u32pair c_utf8b_to_codepoint(const octet* in, uptr in_len, ptr eof) {
 static size_t c_bytes_utf8b_to_string_length(const octet* bytes, size_t len) {
   size_t ret = 0;
   while (len > 0) {
+    const size_t ascii_n = c_ascii_prefix_length(bytes, len);
+    if (ascii_n != 0) {
+      bytes += ascii_n;
+      len -= ascii_n;
+      ret += ascii_n;
+      if (len == 0) {
+        break;
+      }
+    }
     const uint32_t consumed = c_utf8b_to_codepoint_length(bytes, len);
     if (consumed == 0 || consumed > len) {
       break; /* should not happen */
@@ -484,6 +723,22 @@ static sizepair c_bytes_utf8b_to_string_append(
     return c_sizepair(0, 0);
   }
   while (in_len > 0) {
+    size_t ascii_n = c_ascii_prefix_length(in, in_len);
+    if (ascii_n != 0) {
+      size_t i;
+      if (ascii_n > (size_t)(str_end - str_pos)) {
+        ascii_n = (size_t)(str_end - str_pos);
+      }
+      for (i = 0; i < ascii_n; i++) {
+        Sstring_set(str, str_pos + (iptr)i, in[i]);
+      }
+      in += ascii_n;
+      in_len -= ascii_n;
+      str_pos += (iptr)ascii_n;
+      if (in_len == 0) {
+        break;
+      }
+    }
     const u32pair pair = c_utf8b_to_codepoint(in, in_len, eof);
     if (pair.length == 0 || pair.length > in_len || str_pos >= str_end) {
       break;
@@ -557,6 +812,18 @@ ptr schemesh_Sstring_utf8b(const char chars[], size_t len) {
   return Smake_string(-1, 0);
 }
 
+/**
+ * convert a single UTF-8b sequence at the beginning of a C char[] to Unicode codepoint,
+ * and return it. Also store into *consumed the number of converted bytes.
+ * Invalid, overlong or truncated UTF-8 sequences are converted as UTF-8b surrogates.
+ * If len == 0, return 0 and store 0 into *consumed.
+ */
+uint32_t schemesh_utf8b_to_codepoint(const char chars[], const size_t len, size_t* consumed) {
+  const u32pair pair = c_utf8b_to_codepoint((const octet*)chars, len, Strue);
+  *consumed          = pair.length;
+  return pair.codepoint;
+}
+
 /**
  * convert a C char[] to Scheme bytevector and return it.
  * If out of memory, or len > maximum bytevector length, raises condition.
@@ -573,11 +840,223 @@ ptr schemesh_Sbytevector(const char chars[], const size_t len) {
   return bvec;
 }
 
+/* ------------------------------ wire fast paths ----------------------------------------------- */
+
+/*
+ * bulk encoding and decoding of homogeneous containers, used by wire/wire.ss.
+ * The wire format is always little-endian, independently from CPU endianness.
+ */
+
+/**
+ * return the number of bytes needed to serialize each character of a string:
+ * 1 if all characters are <= 0xFF, 2 if all characters are <= 0xFFFF, otherwise 3.
+ */
+static int c_string_wire_width(ptr str) {
+  int width = 1;
+  if (Sstringp(str)) {
+    const iptr n = Sstring_length(str);
+    iptr       i;
+    for (i = 0; i < n; i++) {
+      const string_char ch = Sstring_ref(str, i);
+      if (ch > 0xFFFF) {
+        return 3;
+      } else if (ch > 0xFF) {
+        width = 2;
+      }
+    }
+  }
+  return width;
+}
+
+/**
+ * write all characters of a string into bytevector starting at position pos,
+ * each encoded as width = 1, 2 or 3 bytes little-endian.
+ * Characters that do not fit width bytes are truncated: caller must use c_string_wire_width().
+ *
+ * return position after last byte written,
+ * or -1 if arguments are invalid or bytevector is too small.
+ */
+static iptr c_string_to_wire(ptr str, ptr bvec, iptr pos, int width) {
+  if (Sstringp(str) && Sbytevectorp(bvec) && width >= 1 && width <= 3 && pos >= 0 &&
+      pos <= Sbytevector_length(bvec) &&
+      Sstring_length(str) <= (Sbytevector_length(bvec) - pos) / width) {
+    const iptr n   = Sstring_length(str);
+    octet*     out = Sbytevector_data(bvec) + pos;
+    iptr       i;
+    switch (width) {
+      case 1:
+        for (i = 0; i < n; i++) {
+          out[i] = (octet)Sstring_ref(str, i);
+        }
+        break;
+      case 2:
+        for (i = 0; i < n; i++, out += 2) {
+          const string_char ch = Sstring_ref(str, i);
+          out[0]               = (octet)ch;
+          out[1]               = (octet)(ch >> 8);
+        }
+        break;
+      default:
+        for (i = 0; i < n; i++, out += 3) {
+          const string_char ch = Sstring_ref(str, i);
+          out[0]               = (octet)ch;
+          out[1]               = (octet)(ch >> 8);
+          out[2]               = (octet)(ch >> 16);
+        }
+        break;
+    }
+    return pos + n * width;
+  }
+  return -1;
+}
+
+/**
+ * return nonzero if codepoint can be deserialized as a character:
+ * either a valid Unicode codepoint, or a UTF-8b surrogate in the range 0xDC80 ... 0xDCFF
+ */
+static int c_wire_char_is_valid(const uint32_t codepoint) {
+  return codepoint <= 0xD7FF || (codepoint >= 0xE000 && codepoint <= 0x10FFFF) ||
+         (codepoint >= 0xDC80 && codepoint <= 0xDCFF);
+}
+
+/**
+ * fill a string with the characters read from bytevector starting at position pos,
+ * each encoded as width = 1, 2 or 3 bytes little-endian.
+ * The number of characters to read is the string length.
+ *
+ * return 0 if successful, or -1 if arguments are invalid, bytevector is too small
+ * or some character is invalid.
+ */
+static iptr c_wire_to_string(ptr bvec, iptr pos, int width, ptr str) {
+  if (Sstringp(str) && Sbytevectorp(bvec) && width >= 1 && width <= 3 && pos >= 0 &&
+      pos <= Sbytevector_length(bvec) &&
+      Sstring_length(str) <= (Sbytevector_length(bvec) - pos) / width) {
+    const iptr   n  = Sstring_length(str);
+    const octet* in = Sbytevector_data(bvec) + pos;
+    iptr         i;
+    switch (width) {
+      case 1:
+        for (i = 0; i < n; i++) {
+          Sstring_set(str, i, in[i]);
+        }
+        break;
+      case 2:
+        for (i = 0; i < n; i++, in += 2) {
+          const uint32_t codepoint = in[0] | (uint32_t)in[1] << 8;
+          if (UNLIKELY(!c_wire_char_is_valid(codepoint))) {
+            return -1;
+          }
+          Sstring_set(str, i, codepoint);
+        }
+        break;
+      default:
+        for (i = 0; i < n; i++, in += 3) {
+          const uint32_t codepoint = in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16;
+          if (UNLIKELY(!c_wire_char_is_valid(codepoint))) {
+            return -1;
+          }
+          Sstring_set(str, i, codepoint);
+        }
+        break;
+    }
+    return 0;
+  }
+  return -1;
+}
+
+/**
+ * return the minimum number of bytes, either 1, 2, 4 or 8, needed to serialize
+ * each element of a fxvector as a signed little-endian integer.
+ */
+static int c_fxvector_wire_width(ptr fxvec) {
+  uint64_t bits = 0;
+  if (Sfxvectorp(fxvec)) {
+    const iptr n = Sfxvector_length(fxvec);
+    iptr       i;
+    for (i = 0; i < n; i++) {
+      const int64_t x = Sfixnum_value(Sfxvector_ref(fxvec, i));
+      /* non-negative x needs the same number of bytes as ~x */
+      bits |= (uint64_t)(x < 0 ? ~x : x);
+    }
+  }
+  return bits < 0x80 ? 1 : bits < 0x8000 ? 2 : bits < 0x80000000u ? 4 : 8;
+}
+
+/**
+ * write all elements of a fxvector into bytevector starting at position pos,
+ * each encoded as a signed integer of width = 1, 2, 4 or 8 bytes little-endian.
+ * Elements that do not fit width bytes are truncated: caller must use c_fxvector_wire_width().
+ *
+ * return position after last byte written,
+ * or -1 if arguments are invalid or bytevector is too small.
+ */
+static iptr c_fxvector_to_wire(ptr fxvec, ptr bvec, iptr pos, int width) {
+  if (Sfxvectorp(fxvec) && Sbytevectorp(bvec) &&
+      (width == 1 || width == 2 || width == 4 || width == 8) && pos >= 0 &&
+      pos <= Sbytevector_length(bvec) &&
+      Sfxvector_length(fxvec) <= (Sbytevector_length(bvec) - pos) / width) {
+    const iptr n   = Sfxvector_length(fxvec);
+    octet*     out = Sbytevector_data(bvec) + pos;
+    iptr       i;
+    int        j;
+    for (i = 0; i < n; i++, out += width) {
+      const uint64_t x = (uint64_t)(int64_t)Sfixnum_value(Sfxvector_ref(fxvec, i));
+      for (j = 0; j < width; j++) {
+        out[j] = (octet)(x >> (8 * j));
+      }
+    }
+    return pos + n * width;
+  }
+  return -1;
+}
+
+/**
+ * fill a fxvector with the elements read from bytevector starting at position pos,
+ * each encoded as a signed integer of width = 1, 2, 4 or 8 bytes little-endian.
+ * The number of elements to read is the fxvector length.
+ * fixnum_max must be (greatest-fixnum)
+ *
+ * return 0 if successful, or -1 if arguments are invalid, bytevector is too small
+ * or some element is not a fixnum.
+ */
+static iptr c_wire_to_fxvector(ptr bvec, iptr pos, int width, ptr fxvec, int64_t fixnum_max) {
+  if (Sfxvectorp(fxvec) && Sbytevectorp(bvec) &&
+      (width == 1 || width == 2 || width == 4 || width == 8) && pos >= 0 &&
+      pos <= Sbytevector_length(bvec) &&
+      Sfxvector_length(fxvec) <= (Sbytevector_length(bvec) - pos) / width) {
+    const iptr   n     = Sfxvector_length(fxvec);
+    const int    shift = 64 - 8 * width;
+    const octet* in    = Sbytevector_data(bvec) + pos;
+    iptr         i;
+    int          j;
+    for (i = 0; i < n; i++, in += width) {
+      uint64_t u = 0;
+      int64_t  x;
+      for (j = 0; j < width; j++) {
+        u |= (uint64_t)in[j] << (8 * j);
+      }
+      /* sign-extend */
+      x = shift == 0 ? (int64_t)u : (int64_t)(u << shift) >> shift;
+      if (UNLIKELY(x > fixnum_max || x < -fixnum_max - 1)) {
+        return -1;
+      }
+      Sfxvector_set(fxvec, i, Sfixnum((iptr)x));
+    }
+    return 0;
+  }
+  return -1;
+}
+
 void schemesh_register_c_functions_containers(void) {
   Sregister_symbol("c_bytevector_compare", &c_bytevector_compare);
   Sregister_symbol("c_subbytevector_fill", &c_subbytevector_fill);
+  Sregister_symbol("c_vcellvector_fill", &c_vcellvector_fill);
+  Sregister_symbol("c_vcellvector_copy_string", &c_vcellvector_copy_string);
   Sregister_symbol("c_bytevector_hash", &c_bytevector_hash);
+  Sregister_symbol("c_string_hash", &c_string_hash);
   Sregister_symbol("c_bytevector_index_u8", &c_bytevector_index_u8);
+  Sregister_symbol("c_bytevector_index_all_u8", &c_bytevector_index_all_u8);
+  Sregister_symbol("c_string_index_all_char", &c_string_index_all_char);
   Sregister_symbol("c_string_fill_utf8b_surrogate_chars", &c_string_fill_utf8b_surrogate_chars);
   Sregister_symbol("c_string_to_utf8b_length", &c_string_to_utf8b_length);
   Sregister_symbol("c_string_to_utf8b_append", &c_string_to_utf8b_append);
@@ -586,4 +1065,10 @@ void schemesh_register_c_functions_containers(void) {
   Sregister_symbol("c_bytevector_utf8b_to_string_length", &c_bytevector_utf8b_to_string_length);
 #endif /* 0 */
   Sregister_symbol("c_bytevector_utf8b_to_string_append", &c_bytevector_utf8b_to_string_append);
+  Sregister_symbol("c_string_wire_width", &c_string_wire_width);
+  Sregister_symbol("c_string_to_wire", &c_string_to_wire);
+  Sregister_symbol("c_wire_to_string", &c_wire_to_string);
+  Sregister_symbol("c_fxvector_wire_width", &c_fxvector_wire_width);
+  Sregister_symbol("c_fxvector_to_wire", &c_fxvector_to_wire);
+  Sregister_symbol("c_wire_to_fxvector", &c_wire_to_fxvector);
 }
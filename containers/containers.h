@@ -12,6 +12,7 @@
 
 #include "../chezscheme.h" /* ptr */
 #include <stddef.h>        /* size_t */
+#include <stdint.h>        /* uint32_t */
 
 void schemesh_register_c_functions_containers(void);
 
@@ -28,4 +29,12 @@ ptr schemesh_Sbytevector(const char chars[], const size_t len);
  */
 ptr schemesh_Sstring_utf8b(const char chars[], const size_t len);
 
+/**
+ * convert a single UTF-8b sequence at the beginning of a C char[] to Unicode codepoint,
+ * and return it. Also store into *consumed the number of converted bytes.
+ * Invalid, overlong or truncated UTF-8 sequences are converted as UTF-8b surrogates.
+ * If len == 0, return 0 and store 0 into *consumed.
+ */
+uint32_t schemesh_utf8b_to_codepoint(const char chars[], const size_t len, size_t* consumed);
+
 #endif /* SCHEMESH_CONTAINERS_H */
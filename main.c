@@ -31,8 +31,7 @@ enum jmp_arg {
   QUIT_FAILED = 3,
 };
 
-#if 0 /* not used */
-struct timespec now(void) {
+static struct timespec now(void) {
   struct timespec t;
   (void)clock_gettime(CLOCK_REALTIME, &t);
   return t;
@@ -41,7 +40,16 @@ struct timespec now(void) {
 static double diff(const struct timespec start, const struct timespec end) {
   return (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
 }
-#endif
+
+/** if enabled, print to stderr the time elapsed since *last and update it */
+static void profile_phase(char enabled, struct timespec* last, const char* label) {
+  if (enabled) {
+    struct timespec t = now();
+    fprintf(stderr, "schemesh: startup %-24s %9.6f s\n", label, diff(*last, t));
+    fflush(stderr);
+    *last = t;
+  }
+}
 
 static void handle_scheme_exception(void) {
   longjmp(jmp_env, on_exception);
@@ -68,6 +76,7 @@ static int usage(const char* name) {
       "    -l, --login                 ignored. accepted for compatibility with other shells\n"
       "    --boot-dir DIR              load Chez Scheme boot files from DIR\n"
       "    --library-dir DIR           load schemesh libraries from DIR\n"
+      "    --profile-startup           print to stderr the time spent in each startup phase\n"
       "    --                          end of options. always treat further arguments as files\n"
       "\n"
       "  the type of files, if they are not specified after options '--cmd-file', '--eval-file'\n"
@@ -122,6 +131,7 @@ struct cmdline {
   const char* library_dir;
   char        have_file_or_string;
   char        force_repl;
+  char        profile_startup;
 };
 
 static void parse_command_line(int argc, const char* argv[], struct cmdline* cmd) {
@@ -162,6 +172,8 @@ static void parse_command_line(int argc, const char* argv[], struct cmdline* cmd
       cmd->force_repl = 1;
     } else if (!strcmp(arg, "-l") || !strcmp(arg, "--login")) {
       /* nop */
+    } else if (!strcmp(arg, "--profile-startup")) {
+      cmd->profile_startup = 1;
     } else if (!strcmp(arg, "--version")) {
       /* disable repl unless cmd->force_repl is set */
       cmd->have_file_or_string = 1;
@@ -241,8 +253,9 @@ static void run_files_and_strings(int argc, const char* argv[]) {
 }
 
 int main(int argc, const char* argv[]) {
-  struct cmdline cmd = {};
-  int            err = 0;
+  struct cmdline  cmd = {};
+  struct timespec t0;
+  int             err = 0;
 
   parse_command_line(argc, argv, &cmd);
 
@@ -260,21 +273,35 @@ int main(int argc, const char* argv[]) {
   }
 
   on_exception = INIT_FAILED;
-  schemesh_init(cmd.boot_dir, &handle_scheme_exception);
-  if ((err = schemesh_register_c_functions()) != 0) {
-    goto finish;
-  }
-  if ((err = schemesh_load_libraries(cmd.library_dir)) != 0) {
+  t0           = now();
+  err          = schemesh_init_with_libraries(cmd.boot_dir, cmd.library_dir, &handle_scheme_exception);
+  if (err < 0) {
     goto finish;
+  } else if (err == 1) {
+    /* schemesh libraries were loaded from LIBSCHEMESH_BOOT */
+    profile_phase(cmd.profile_startup, &t0, "init+load boot file");
+  } else {
+    profile_phase(cmd.profile_startup, &t0, "init");
+    if ((err = schemesh_register_c_functions()) != 0) {
+      goto finish;
+    }
+    profile_phase(cmd.profile_startup, &t0, "register C functions");
+    if ((err = schemesh_load_libraries(cmd.library_dir)) != 0) {
+      goto finish;
+    }
+    profile_phase(cmd.profile_startup, &t0, "load libraries");
   }
+  err = 0;
 
   schemesh_import_all_libraries();
+  profile_phase(cmd.profile_startup, &t0, "import libraries");
 
   Senable_expeditor(NULL);
   errno = 0;
 
   if (cmd.have_file_or_string) {
     run_files_and_strings(argc, argv);
+    profile_phase(cmd.profile_startup, &t0, "run files and strings");
   }
   if (cmd.force_repl == 0 && cmd.have_file_or_string) {
     goto finish;
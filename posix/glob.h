@@ -0,0 +1,761 @@
+/**
+ * Copyright (C) 2023-2025 by Massimiliano Ghilardi
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/** this file should be included only by posix/posix.c */
+#ifndef SCHEMESH_POSIX_POSIX_C
+#error "posix/glob.h should only be #included by posix/posix.c"
+#endif
+
+/* ------------------------------------ glob expansion ------------------------------------------ */
+
+/*
+ * Expand a path containing shell wildcards, matching each directory entry during readdir().
+ * Independent subdirectories are scanned in parallel by a small pool of threads,
+ * and matching paths can be retrieved incrementally while the scan is still running.
+ *
+ * The path is described by a Scheme vector of segments, created by (sh-patterns->c-glob)
+ * in shell/wildcard.ss. Each segment is either:
+ *   a bytevector, i.e. a literal path fragment in UTF-8b, that may contain '/'
+ *   a vector #(flags op ...) i.e. a pattern matching a single directory entry, where
+ *     flags is a fixnum containing a combination of e_glob_flags
+ *     each op is a fixnum in e_glob_op, optionally followed by a UTF-8b bytevector argument:
+ *       g_star and g_question have no argument,
+ *       g_alt and g_alt_not alternatives are followed by the alternative characters, which may contain ranges "a-z"
+ *     a bytevector not preceded by g_alt or g_alt_not is a literal string to match.
+ */
+
+typedef enum { g_star = 1, g_question = 2, g_alt = 3, g_alt_not = 4, g_literal = 5 } e_glob_op;
+
+typedef enum {
+  g_wildcard         = 1, /* pattern contains wildcards: never match "." or ".." */
+  g_leading_wildcard = 2, /* pattern starts with a wildcard: never match names starting with '.' */
+  g_dir              = 4, /* pattern ends with '/': only match directories, and append '/' to them */
+} e_glob_flags;
+
+enum { glob_threads_max = 8 };
+
+typedef struct {
+  const char*     bytes; /* g_literal: UTF-8b bytes to match */
+  const uint32_t* chars; /* g_alt, g_alt_not: alternative codepoints */
+  uint32_t        len;   /* number of bytes or codepoints */
+  unsigned char   op;    /* one of e_glob_op */
+  unsigned char   range; /* g_alt, g_alt_not: nonzero if chars contain ranges "a-z" */
+} s_glob_op;
+
+typedef struct {
+  s_glob_op*       ops;     /* NULL if segment is a literal path fragment */
+  const char*      literal; /* literal path fragment */
+  size_t           len;     /* number of ops, or number of bytes in literal */
+  int              flags;   /* combination of e_glob_flags */
+} s_glob_seg;
+
+typedef struct s_glob_task {
+  struct s_glob_task* next;
+  size_t              seg_i;    /* index of first segment still to match */
+  size_t              path_len; /* length of path, excluding final '\0' */
+  char                path[];   /* followed by '\0' and by a flag byte, see c_glob_task_new() */
+} s_glob_task;
+
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t  cond; /* broadcast whenever tasks, results or busy_n change */
+  s_glob_seg*     segs;
+  size_t          seg_n;
+  void*           arena; /* single allocation containing segs and their contents */
+  s_glob_task*    tasks; /* stack of directories still to scan */
+  size_t          task_n;
+  char**          results;
+  size_t          result_n;
+  size_t          result_cap;
+  size_t          result_taken; /* number of results already moved to ready by c_glob_wait() */
+  char**          ready;        /* paths collected by c_glob_wait(), not yet returned by c_glob_next() */
+  size_t          ready_n;
+  unsigned        busy_n;       /* number of threads currently executing a task */
+  unsigned        thread_n;
+  unsigned        thread_max;
+  int             err; /* c_errno() of first failure, for example -ENOMEM, or 0 */
+  ATOMIC int      cancel;
+  pthread_t       threads[glob_threads_max];
+} s_glob;
+
+/** return the number of helper threads to use, in addition to the calling thread */
+static unsigned c_glob_thread_max(void) {
+  const long n = sysconf(_SC_NPROCESSORS_ONLN);
+  if (n <= 1) {
+    return 0;
+  }
+  return n > glob_threads_max ? glob_threads_max : (unsigned)(n - 1);
+}
+
+/**
+ * parse a vector of segments and copy it into a single C allocation, stored into *ret_arena.
+ * return 0 on success, or c_errno() on error: -EINVAL if vector is malformed, -ENOMEM if out of memory
+ */
+static int c_glob_parse(ptr          vector_segments,
+                        void**       ret_arena,
+                        s_glob_seg** ret_segs,
+                        size_t*      ret_seg_n) {
+  const iptr  seg_n = Svectorp(vector_segments) ? Svector_length(vector_segments) : -1;
+  size_t      size  = 0;
+  iptr        i, j;
+  char*       arena;
+  char*       pos;
+  s_glob_seg* segs;
+
+  if (seg_n <= 0) {
+    return c_errno_set(EINVAL);
+  }
+  /* first pass: validate and compute the needed size */
+  size = (size_t)seg_n * sizeof(s_glob_seg);
+  for (i = 0; i < seg_n; i++) {
+    ptr seg = Svector_ref(vector_segments, i);
+    if (Sbytevectorp(seg)) {
+      size += (size_t)Sbytevector_length(seg);
+    } else if (Svectorp(seg) && Svector_length(seg) >= 1 && Sfixnump(Svector_ref(seg, 0))) {
+      const iptr n = Svector_length(seg);
+      for (j = 1; j < n; j++) {
+        ptr elem = Svector_ref(seg, j);
+        if (Sbytevectorp(elem)) {
+          /* worst case: one codepoint per byte */
+          size += sizeof(s_glob_op) + (size_t)Sbytevector_length(elem) * sizeof(uint32_t);
+        } else if (Sfixnump(elem) && Sfixnum_value(elem) >= g_star &&
+                   Sfixnum_value(elem) <= g_alt_not) {
+          if (Sfixnum_value(elem) >= g_alt) {
+            if (j + 1 >= n || !Sbytevectorp(Svector_ref(seg, j + 1))) {
+              return c_errno_set(EINVAL);
+            }
+          }
+          size += sizeof(s_glob_op);
+        } else {
+          return c_errno_set(EINVAL);
+        }
+      }
+    } else {
+      return c_errno_set(EINVAL);
+    }
+  }
+  /* second pass: copy. s_glob_op and uint32_t arrays first, then bytes - respects alignment */
+  if (!(arena = malloc(size))) {
+    return c_errno_set(ENOMEM);
+  }
+  segs = (s_glob_seg*)arena;
+  pos  = arena + (size_t)seg_n * sizeof(s_glob_seg);
+  for (i = 0; i < seg_n; i++) {
+    ptr         seg = Svector_ref(vector_segments, i);
+    s_glob_seg* out = &segs[i];
+    if (Sbytevectorp(seg)) {
+      continue; /* literal bytes are copied below */
+    }
+    {
+      const iptr n   = Svector_length(seg);
+      s_glob_op* ops = (s_glob_op*)pos;
+      size_t     k   = 0;
+      out->ops       = ops;
+      out->literal   = NULL;
+      out->flags     = (int)Sfixnum_value(Svector_ref(seg, 0));
+      for (j = 1; j < n; j++) {
+        ptr elem = Svector_ref(seg, j);
+        memset(&ops[k], '\0', sizeof(s_glob_op));
+        if (Sbytevectorp(elem)) {
+          ops[k].op = g_literal;
+        } else {
+          ops[k].op = (unsigned char)Sfixnum_value(elem);
+          if (ops[k].op >= g_alt) {
+            ++j; /* skip alternatives, they follow the op */
+          }
+        }
+        /* temporarily store the Scheme bytevector index, resolved below */
+        ops[k].len = (uint32_t)j;
+        k++;
+      }
+      out->len = k;
+      pos += k * sizeof(s_glob_op);
+    }
+  }
+  /* third pass: codepoints of alternatives */
+  for (i = 0; i < seg_n; i++) {
+    ptr    seg = Svector_ref(vector_segments, i);
+    size_t k;
+    if (Sbytevectorp(seg)) {
+      continue;
+    }
+    for (k = 0; k < segs[i].len; k++) {
+      s_glob_op* op = &segs[i].ops[k];
+      if (op->op == g_alt || op->op == g_alt_not) {
+        ptr          bvec  = Svector_ref(seg, op->len);
+        const char*  bytes = (const char*)Sbytevector_data(bvec);
+        const size_t blen  = (size_t)Sbytevector_length(bvec);
+        uint32_t*    chars = (uint32_t*)pos;
+        size_t       off = 0, consumed, n = 0;
+        while (off < blen) {
+          chars[n++] = schemesh_utf8b_to_codepoint(bytes + off, blen - off, &consumed);
+          off += consumed;
+        }
+        op->chars = chars;
+        op->len   = (uint32_t)n;
+        /* same rule as (%pattern-match/alternative): a '-' not at the beginning nor at the end */
+        for (off = 1; off + 1 < n; off++) {
+          if (chars[off] == '-') {
+            op->range = 1;
+            break;
+          }
+        }
+        pos += n * sizeof(uint32_t);
+      }
+    }
+  }
+  /* fourth pass: bytes of literals */
+  for (i = 0; i < seg_n; i++) {
+    ptr    seg = Svector_ref(vector_segments, i);
+    size_t k;
+    if (Sbytevectorp(seg)) {
+      const size_t len = (size_t)Sbytevector_length(seg);
+      memcpy(pos, Sbytevector_data(seg), len);
+      segs[i].ops     = NULL;
+      segs[i].literal = pos;
+      segs[i].len     = len;
+      segs[i].flags   = 0;
+      pos += len;
+      continue;
+    }
+    for (k = 0; k < segs[i].len; k++) {
+      s_glob_op* op = &segs[i].ops[k];
+      if (op->op == g_literal) {
+        ptr          bvec = Svector_ref(seg, op->len);
+        const size_t len  = (size_t)Sbytevector_length(bvec);
+        memcpy(pos, Sbytevector_data(bvec), len);
+        op->bytes = pos;
+        op->len   = (uint32_t)len;
+        pos += len;
+      } else if (op->op < g_alt) {
+        op->len = 0;
+      }
+    }
+  }
+  *ret_arena = arena;
+  *ret_segs  = segs;
+  *ret_seg_n = (size_t)seg_n;
+  return 0;
+}
+
+/** return nonzero if codepoint ch is matched by alternatives of op, ignoring g_alt_not */
+static int c_glob_alt_match(const s_glob_op* op, uint32_t ch) {
+  const uint32_t* chars = op->chars;
+  const uint32_t  n     = op->len;
+  uint32_t        i;
+  if (!op->range) {
+    for (i = 0; i < n; i++) {
+      if (chars[i] == ch) {
+        return 1;
+      }
+    }
+    return 0;
+  }
+  for (i = 0; i < n;) {
+    if (i + 2 < n && chars[i + 1] == '-') {
+      if (chars[i] <= ch && ch <= chars[i + 2]) {
+        return 1;
+      }
+      i += 3;
+    } else if (chars[i] == ch) {
+      return 1;
+    } else {
+      i++;
+    }
+  }
+  return 0;
+}
+
+/**
+ * match a single op against the beginning of name[0, len).
+ * return the number of matched bytes, or (size_t)-1 if op does not match.
+ * g_star is handled by caller.
+ */
+static size_t c_glob_match_op(const s_glob_op* op, const char* name, size_t len) {
+  size_t   consumed;
+  uint32_t ch;
+  switch (op->op) {
+    case g_literal:
+      return len >= op->len && memcmp(name, op->bytes, op->len) == 0 ? op->len : (size_t)-1;
+    case g_question:
+      if (len == 0) {
+        return (size_t)-1;
+      }
+      (void)schemesh_utf8b_to_codepoint(name, len, &consumed);
+      return consumed;
+    case g_alt:
+    case g_alt_not:
+      if (len == 0 || op->len == 0) {
+        return (size_t)-1;
+      }
+      ch = schemesh_utf8b_to_codepoint(name, len, &consumed);
+      return (c_glob_alt_match(op, ch) != 0) == (op->op == g_alt) ? consumed : (size_t)-1;
+    default:
+      return (size_t)-1;
+  }
+}
+
+/**
+ * return nonzero if pattern segment seg matches name[0, len), otherwise return zero.
+ * Same rules as (sh-pattern-match?) in posix/pattern.ss
+ */
+static int c_glob_match(const s_glob_seg* seg, const char* name, size_t len) {
+  const s_glob_op* ops      = seg->ops;
+  const size_t     op_n     = seg->len;
+  size_t           op_i     = 0;
+  size_t           pos      = 0;
+  size_t           star_op  = (size_t)-1; /* index of op after last '*' */
+  size_t           star_pos = 0;          /* position in name where last '*' match ends */
+
+  if ((seg->flags & g_wildcard) &&
+      ((len == 1 && name[0] == '.') || (len == 2 && name[0] == '.' && name[1] == '.'))) {
+    return 0;
+  }
+  if ((seg->flags & g_leading_wildcard) && len != 0 && name[0] == '.') {
+    return 0;
+  }
+  for (;;) {
+    if (op_i < op_n && ops[op_i].op == g_star) {
+      star_op  = ++op_i;
+      star_pos = pos;
+      continue;
+    }
+    if (op_i < op_n) {
+      const size_t n = c_glob_match_op(&ops[op_i], name + pos, len - pos);
+      if (n != (size_t)-1) {
+        op_i++;
+        pos += n;
+        continue;
+      }
+    } else if (pos == len) {
+      return 1;
+    }
+    /* mismatch: let last '*' match one more character, and retry */
+    if (star_op == (size_t)-1 || star_pos >= len) {
+      return 0;
+    }
+    {
+      size_t consumed;
+      (void)schemesh_utf8b_to_codepoint(name + star_pos, len - star_pos, &consumed);
+      star_pos += consumed;
+    }
+    op_i = star_op;
+    pos  = star_pos;
+  }
+}
+
+/**
+ * append path2[0, len2) to path1[0, len1) with the same rules as (%path-append). return malloc()ed task.
+ * path is followed by '\0' and by a flag byte, initially zero: nonzero means that path is a directory,
+ * and is only set for results that do not already end with '/'.
+ */
+static s_glob_task* c_glob_task_new(const char* path1,
+                                    size_t      len1,
+                                    const char* path2,
+                                    size_t      len2,
+                                    int         append_slash,
+                                    size_t      seg_i) {
+  s_glob_task* task;
+  int          skip = 0, sep = 0;
+  if (len1 != 0 && len2 != 0) {
+    const int slash1 = path1[len1 - 1] == '/';
+    const int slash2 = path2[0] == '/';
+    skip             = slash1 && slash2;
+    sep              = !slash1 && !slash2;
+  }
+  task = malloc(sizeof(s_glob_task) + len1 + sep + len2 - skip + (append_slash != 0) + 2);
+  if (task) {
+    char*  out = task->path;
+    size_t len = 0;
+    memcpy(out, path1, len1);
+    len += len1;
+    if (sep) {
+      out[len++] = '/';
+    }
+    memcpy(out + len, path2 + skip, len2 - skip);
+    len += len2 - skip;
+    if (append_slash) {
+      out[len++] = '/';
+    }
+    out[len]       = '\0';
+    out[len + 1]   = 0;
+    task->next     = NULL;
+    task->seg_i    = seg_i;
+    task->path_len = len;
+  }
+  return task;
+}
+
+static void* c_glob_thread_main(void* arg);
+
+/** record the first failure and stop the expansion. must be called with g->lock held */
+static void c_glob_fail_locked(s_glob* g, int err) {
+  if (g->err == 0) {
+    g->err = err;
+  }
+  g->cancel = 1;
+  (void)pthread_cond_broadcast(&g->cond);
+}
+
+static void c_glob_fail(s_glob* g, int err) {
+  (void)pthread_mutex_lock(&g->lock);
+  c_glob_fail_locked(g, err);
+  (void)pthread_mutex_unlock(&g->lock);
+}
+
+/** add a task or a result. takes ownership of task. must be called with g->lock held */
+static void c_glob_push_locked(s_glob* g, s_glob_task* task) {
+  if (task->seg_i >= g->seg_n) {
+    /* task is a result: convert it in-place to a plain string */
+    char* path = (char*)task;
+    if (g->result_n == g->result_cap) {
+      const size_t cap     = g->result_cap ? g->result_cap * 2 : 64;
+      char**       results = realloc(g->results, cap * sizeof(char*));
+      if (!results) {
+        free(task);
+        c_glob_fail_locked(g, c_errno_set(ENOMEM));
+        return;
+      }
+      g->results    = results;
+      g->result_cap = cap;
+    }
+    memmove(path, task->path, task->path_len + 2); /* also copy '\0' and flag byte */
+    g->results[g->result_n++] = path;
+  } else {
+    task->next = g->tasks;
+    g->tasks   = task;
+    g->task_n++;
+    /* more than one pending directory: start one more helper thread, if allowed */
+    if (g->task_n > 1 && g->thread_n < g->thread_max &&
+        pthread_create(&g->threads[g->thread_n], NULL, c_glob_thread_main, g) == 0) {
+      g->thread_n++;
+    }
+  }
+  (void)pthread_cond_broadcast(&g->cond);
+}
+
+/** add a task or a result. takes ownership of task. if task is NULL, record that allocating it failed */
+static void c_glob_push(s_glob* g, s_glob_task* task) {
+  (void)pthread_mutex_lock(&g->lock);
+  if (task) {
+    c_glob_push_locked(g, task);
+  } else {
+    c_glob_fail_locked(g, c_errno_set(ENOMEM));
+  }
+  (void)pthread_mutex_unlock(&g->lock);
+}
+
+/** return nonzero if directory entry is a directory, resolving symlinks */
+static int c_glob_is_dir(DIR* dir, const struct dirent* entry) {
+  struct stat buf;
+  switch (entry->d_type) {
+    case DT_DIR:
+      return 1;
+    case DT_LNK:
+    case DT_UNKNOWN:
+      return fstatat(dirfd(dir), entry->d_name, &buf, 0) == 0 && S_ISDIR(buf.st_mode);
+    default:
+      return 0;
+  }
+}
+
+/** execute a task, i.e. match the remaining segments starting from task->path. Frees task */
+static void c_glob_run(s_glob* g, s_glob_task* task) {
+  const s_glob_seg* seg;
+  size_t            seg_i = task->seg_i;
+
+  /* literal segments: append them to path, no need to scan directories */
+  while (seg_i < g->seg_n && g->segs[seg_i].ops == NULL) {
+    s_glob_task* next = c_glob_task_new(
+        task->path, task->path_len, g->segs[seg_i].literal, g->segs[seg_i].len, 0, seg_i + 1);
+    free(task);
+    if (!(task = next)) {
+      c_glob_fail(g, c_errno_set(ENOMEM));
+      return;
+    }
+    seg_i++;
+  }
+  if (seg_i >= g->seg_n) {
+    /* path ends with literal segments: check that it exists. Use lstat() as wildcards do,
+     * because they match directory entries: dangling symlinks must match too */
+    struct stat buf;
+    if (lstat(task->path, &buf) == 0) {
+      c_glob_push(g, task);
+    } else {
+      free(task);
+    }
+    return;
+  }
+  seg = &g->segs[seg_i];
+  {
+    DIR*           dir = opendir(task->path_len ? task->path : ".");
+    struct dirent* entry;
+    if (!dir) {
+      free(task);
+      return;
+    }
+    while (!g->cancel && (entry = readdir(dir)) != NULL) {
+      const size_t namelen = strlen(entry->d_name);
+      if (!c_glob_match(seg, entry->d_name, namelen)) {
+        continue;
+      }
+      /* only directories can match a pattern ending with '/' */
+      if ((seg->flags & g_dir) && !c_glob_is_dir(dir, entry)) {
+        continue;
+      }
+      {
+        s_glob_task* next = c_glob_task_new(
+            task->path, task->path_len, entry->d_name, namelen, seg->flags & g_dir, seg_i + 1);
+        /* results are sorted as if directories ended with '/', see c_glob_compare() */
+        if (next && seg_i + 1 >= g->seg_n && !(seg->flags & g_dir)) {
+          next->path[next->path_len + 1] = (char)c_glob_is_dir(dir, entry);
+        }
+        c_glob_push(g, next);
+      }
+    }
+    (void)closedir(dir);
+  }
+  free(task);
+}
+
+/**
+ * pop a task, execute it, and return 1.
+ * if no task is available, return 0. must be called with g->lock held
+ */
+static int c_glob_run_one_locked(s_glob* g) {
+  s_glob_task* task = g->tasks;
+  if (!task) {
+    return 0;
+  }
+  g->tasks = task->next;
+  g->task_n--;
+  g->busy_n++;
+  (void)pthread_mutex_unlock(&g->lock);
+
+  c_glob_run(g, task);
+
+  (void)pthread_mutex_lock(&g->lock);
+  if (--g->busy_n == 0 && !g->tasks) {
+    (void)pthread_cond_broadcast(&g->cond); /* finished */
+  }
+  return 1;
+}
+
+static void* c_glob_thread_main(void* arg) {
+  s_glob* g = (s_glob*)arg;
+  (void)pthread_mutex_lock(&g->lock);
+  while (!g->cancel && (g->tasks || g->busy_n != 0)) {
+    if (!c_glob_run_one_locked(g)) {
+      (void)pthread_cond_wait(&g->cond, &g->lock);
+    }
+  }
+  (void)pthread_mutex_unlock(&g->lock);
+  return NULL;
+}
+
+/**
+ * start expanding the glob described by vector_segments, starting from directory
+ * bytevector0_dir, which must be a 0-terminated bytevector. An empty string means current directory.
+ *
+ * Does not scan any directory yet: call c_glob_next() to retrieve matching paths,
+ * then c_glob_end() to release resources.
+ *
+ * return a Scheme integer > 0 i.e. the handle to pass to c_glob_next() and c_glob_end(),
+ * or Scheme integer -errno on error.
+ */
+static ptr c_glob_start(ptr bytevector0_dir, ptr vector_segments) {
+  s_glob*      g;
+  s_glob_task* task;
+  iptr         dirlen;
+  int          err;
+  if (!Sbytevectorp(bytevector0_dir) || (dirlen = Sbytevector_length(bytevector0_dir)) <= 0 ||
+      Sbytevector_data(bytevector0_dir)[dirlen - 1] != '\0') {
+    return Sinteger(c_errno_set(EINVAL));
+  }
+  if (!(g = calloc(1, sizeof(s_glob)))) {
+    return Sinteger(c_errno_set(ENOMEM));
+  }
+  if ((err = c_glob_parse(vector_segments, &g->arena, &g->segs, &g->seg_n)) < 0) {
+    free(g);
+    return Sinteger(err);
+  }
+  task = c_glob_task_new((const char*)Sbytevector_data(bytevector0_dir), dirlen - 1, "", 0, 0, 0);
+  if (!task) {
+    free(g->arena);
+    free(g);
+    return Sinteger(c_errno_set(ENOMEM));
+  }
+  (void)pthread_mutex_init(&g->lock, NULL);
+  (void)pthread_cond_init(&g->cond, NULL);
+  g->thread_max = c_glob_thread_max();
+  g->tasks      = task;
+  g->task_n     = 1;
+  return Sunsigned((uptr)g);
+}
+
+/**
+ * decode the codepoint at path[*pos] of a glob result path[0, len), and advance *pos.
+ * if dir != 0, path is followed by a virtual '/'. return 0 at the end of path.
+ */
+static uint32_t c_glob_result_char(const char* path, size_t len, int dir, size_t* pos) {
+  size_t   consumed = 1;
+  uint32_t ch;
+  if (*pos < len) {
+    const unsigned char byte = (unsigned char)path[*pos];
+    ch = byte < 0x80 ? byte : schemesh_utf8b_to_codepoint(path + *pos, len - *pos, &consumed);
+  } else if (*pos == len && dir) {
+    ch = '/';
+  } else {
+    return 0;
+  }
+  *pos += consumed;
+  return ch;
+}
+
+/**
+ * compare two glob results in the same order as the previous Scheme implementation,
+ * which sorted the names inside each directory with (directory-sort!) i.e. string<?
+ * after appending '/' to directories: compare the codepoints decoded from UTF-8b,
+ * with each directory followed by '/'.
+ * Since names in the same directory are unique, comparing whole paths gives the same order.
+ */
+static int c_glob_compare(const void* a, const void* b) {
+  const char*  pa = *(const char* const*)a;
+  const char*  pb = *(const char* const*)b;
+  const size_t la = strlen(pa), lb = strlen(pb);
+  const int    da = pa[la + 1] != 0, db = pb[lb + 1] != 0;
+  size_t       ia = 0, ib = 0;
+  for (;;) {
+    const uint32_t ca = c_glob_result_char(pa, la, da, &ia);
+    const uint32_t cb = c_glob_result_char(pb, lb, db, &ib);
+    if (ca != cb) {
+      return ca < cb ? -1 : 1;
+    } else if (ca == 0) {
+      return 0;
+    }
+  }
+}
+
+/**
+ * collect matching paths from a glob started with c_glob_start(), for retrieving them with c_glob_next().
+ * Also scans directories in the calling thread, and waits for helper threads if needed.
+ *
+ * if sorted == 0, return as soon as some matching paths are available:
+ *   collects the matching paths found since previous call, in arbitrary order.
+ *   collects no paths if expansion is finished and all matching paths were already collected.
+ * if sorted != 0, wait until expansion is finished,
+ *   then collect all the matching paths not collected yet, sorted.
+ *
+ * Does not access Scheme objects, thus it can be called as __collect_safe:
+ * the Scheme thread is deactivated while waiting, and does not block garbage collections.
+ * return number of collected paths, or c_errno() on error: -ENOMEM if some allocation failed,
+ * in which case the expansion is stopped.
+ */
+static iptr c_glob_wait(uptr handle, int sorted) {
+  s_glob* g = (s_glob*)handle;
+  char**  paths;
+  size_t  n;
+  if (!g || g->ready) {
+    return c_errno_set(EINVAL);
+  }
+  (void)pthread_mutex_lock(&g->lock);
+  while (!g->cancel && (g->tasks || g->busy_n != 0)) {
+    if (!sorted && g->result_taken < g->result_n) {
+      break;
+    }
+    if (!c_glob_run_one_locked(g)) {
+      (void)pthread_cond_wait(&g->cond, &g->lock);
+    }
+  }
+  if (g->err != 0) {
+    const int err = g->err;
+    (void)pthread_mutex_unlock(&g->lock);
+    return err;
+  }
+  if (sorted && g->result_n - g->result_taken > 1) {
+    qsort(g->results + g->result_taken,
+          g->result_n - g->result_taken,
+          sizeof(char*),
+          c_glob_compare);
+  }
+  /* helper threads may realloc() g->results: copy the paths before releasing the lock */
+  n     = g->result_n - g->result_taken;
+  paths = n ? malloc(n * sizeof(char*)) : NULL;
+  if (paths) {
+    memcpy(paths, g->results + g->result_taken, n * sizeof(char*));
+    g->result_taken = g->result_n;
+  } else if (n != 0) {
+    (void)pthread_mutex_unlock(&g->lock);
+    return c_errno_set(ENOMEM);
+  }
+  (void)pthread_mutex_unlock(&g->lock);
+  g->ready   = paths;
+  g->ready_n = n;
+  return (iptr)n;
+}
+
+/**
+ * return a Scheme list containing the matching paths collected by the last call to c_glob_wait(),
+ * then forget them. Creating Scheme strings may raise a condition, thus it must not be __collect_safe.
+ */
+static ptr c_glob_next(uptr handle) {
+  s_glob* g   = (s_glob*)handle;
+  ptr     ret = Snil;
+  char**  paths;
+  size_t  i;
+  if (!g || !(paths = g->ready)) {
+    return ret;
+  }
+  i          = g->ready_n;
+  g->ready   = NULL;
+  g->ready_n = 0;
+  for (; i > 0; i--) {
+    ret = Scons(schemesh_Sstring_utf8b(paths[i - 1], (size_t)-1), ret);
+    free(paths[i - 1]);
+  }
+  free(paths);
+  return ret;
+}
+
+/**
+ * stop a glob started with c_glob_start(), wait for its helper threads, and release its resources.
+ * Does not access Scheme objects, thus it can be called as __collect_safe.
+ */
+static void c_glob_end(uptr handle) {
+  s_glob*  g = (s_glob*)handle;
+  unsigned i;
+  size_t   j;
+  if (!g) {
+    return;
+  }
+  (void)pthread_mutex_lock(&g->lock);
+  g->cancel = 1;
+  (void)pthread_cond_broadcast(&g->cond);
+  (void)pthread_mutex_unlock(&g->lock);
+  for (i = 0; i < g->thread_n; i++) {
+    (void)pthread_join(g->threads[i], NULL);
+  }
+  while (g->tasks) {
+    s_glob_task* next = g->tasks->next;
+    free(g->tasks);
+    g->tasks = next;
+  }
+  for (j = g->result_taken; j < g->result_n; j++) {
+    free(g->results[j]);
+  }
+  for (j = 0; j < g->ready_n; j++) {
+    free(g->ready[j]);
+  }
+  free(g->ready);
+  free(g->results);
+  (void)pthread_cond_destroy(&g->cond);
+  (void)pthread_mutex_destroy(&g->lock);
+  free(g->arena);
+  free(g);
+}
@@ -0,0 +1,292 @@
+/**
+ * Copyright (C) 2023-2025 by Massimiliano Ghilardi
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/** this file should be included only by posix/posix.c */
+#ifndef SCHEMESH_POSIX_POSIX_C
+#error "posix/linemap.h should only be #included by posix/posix.c"
+#endif
+
+/* ------------------------------------ line map ------------------------------------------------ */
+
+/*
+ * Read-only memory map of a text file, plus a compact index of line offsets.
+ * Used by screen/vhistory-io.ss to load history files lazily:
+ * each line is copied into a Scheme bytevector only when (c_linemap_ref) is called on it.
+ */
+
+#include <sys/file.h> /* flock() */
+#include <sys/mman.h> /* mmap(), munmap() */
+
+typedef struct s_linemap {
+  const octet* addr;       /* NULL if file is empty */
+  size_t       size;       /* file size in bytes */
+  uint32_t     count;      /* number of lines */
+  uint32_t     offsets[1]; /* count + 1 elements: i-th line is [offsets[i], offsets[i+1] - 1) */
+} s_linemap;
+
+/**
+ * memory map the file open as fd, which can be closed afterwards, and index its lines.
+ * return a Scheme integer > 0 i.e. the handle to pass to other c_linemap_...() functions,
+ * or a Scheme integer < 0 i.e. c_errno() on error.
+ */
+static ptr c_linemap_open(int fd) {
+  struct stat  st;
+  s_linemap*   lm;
+  const octet* addr = NULL;
+  const octet* pos;
+  const octet* end;
+  size_t       size, count = 0;
+  uint32_t     i = 0;
+  if (fstat(fd, &st) < 0) {
+    return Sinteger(c_errno());
+  }
+  size = (size_t)st.st_size;
+  if (st.st_size < 0 || (uint64_t)st.st_size >= (uint64_t)0xFFFFFFFFu) {
+    return Sinteger(c_errno_set(EFBIG)); /* offsets are 32 bit */
+  }
+  if (size != 0) {
+    addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      return Sinteger(c_errno());
+    }
+    for (pos = addr, end = addr + size; (pos = memchr(pos, '\n', end - pos)) != NULL; pos++) {
+      count++;
+    }
+    if (addr[size - 1] != '\n') {
+      count++; /* last line has no newline */
+    }
+  }
+  lm = malloc(sizeof(s_linemap) + count * sizeof(uint32_t));
+  if (lm == NULL) {
+    if (addr != NULL) {
+      (void)munmap((void*)addr, size);
+    }
+    return Sinteger(c_errno_set(ENOMEM));
+  }
+  lm->addr       = addr;
+  lm->size       = size;
+  lm->count      = (uint32_t)count;
+  lm->offsets[0] = 0;
+  if (addr != NULL) {
+    for (pos = addr, end = addr + size; (pos = memchr(pos, '\n', end - pos)) != NULL;) {
+      lm->offsets[++i] = (uint32_t)(++pos - addr);
+    }
+    if (i < count) {
+      lm->offsets[++i] = (uint32_t)size + 1; /* pretend last line has a newline */
+    }
+  }
+  return Sunsigned((uptr)lm);
+}
+
+/** unmap and free a linemap created by c_linemap_open() */
+static void c_linemap_close(uptr handle) {
+  s_linemap* lm = (s_linemap*)handle;
+  if (lm != NULL) {
+    if (lm->addr != NULL) {
+      (void)munmap((void*)lm->addr, lm->size);
+    }
+    free(lm);
+  }
+}
+
+/** return the number of lines in a linemap */
+static iptr c_linemap_count(uptr handle) {
+  s_linemap* lm = (s_linemap*)handle;
+  return lm != NULL ? (iptr)lm->count : 0;
+}
+
+/**
+ * check whether the file open as fd has a different size than the one mapped by linemap,
+ * for example because another process appended to it after c_linemap_open().
+ * return 0 if size is unchanged, 1 if it changed, or c_errno() on error.
+ */
+static int c_linemap_changed(uptr handle, int fd) {
+  s_linemap*  lm = (s_linemap*)handle;
+  struct stat st;
+  if (lm == NULL) {
+    return c_errno_set(EINVAL);
+  }
+  if (fstat(fd, &st) < 0) {
+    return c_errno();
+  }
+  return (uint64_t)st.st_size == (uint64_t)lm->size ? 0 : 1;
+}
+
+/**
+ * lock the file open as fd with flock(): exclusive if exclusive != 0, otherwise shared.
+ * Block until the lock is acquired, and release it when fd is closed.
+ *
+ * Does not access Scheme objects, thus it can be called as __collect_safe.
+ * return 0 if successful, or c_errno() on error.
+ */
+static int c_linemap_lock(int fd, int exclusive) {
+  int err;
+  do {
+    err = flock(fd, exclusive ? LOCK_EX : LOCK_SH) == 0 ? 0 : c_errno();
+  } while (err == -EINTR);
+  return err;
+}
+
+/**
+ * check whether the file open as fd is still the file named by path0,
+ * which must be a NUL-terminated bytevector.
+ * return 0 if it is, 1 if path0 was replaced by a different file or removed, or c_errno() on error.
+ */
+static int c_linemap_same_file(int fd, ptr path0) {
+  struct stat st_fd, st_path;
+  if (fstat(fd, &st_fd) < 0) {
+    return c_errno();
+  }
+  if (stat((const char*)Sbytevector_data(path0), &st_path) < 0) {
+    return errno == ENOENT ? 1 : c_errno();
+  }
+  return st_fd.st_dev == st_path.st_dev && st_fd.st_ino == st_path.st_ino ? 0 : 1;
+}
+
+/** return a new bytevector containing the i-th line of linemap, without its newline, or #f if out of range */
+static ptr c_linemap_ref(uptr handle, iptr i) {
+  s_linemap* lm = (s_linemap*)handle;
+  ptr        bvec;
+  uint32_t   start, len;
+  if (lm == NULL || i < 0 || (uptr)i >= lm->count) {
+    return Sfalse;
+  }
+  start = lm->offsets[i];
+  len   = lm->offsets[i + 1] - 1 - start;
+  bvec  = Smake_bytevector(len, 0);
+  memcpy(Sbytevector_data(bvec), lm->addr + start, len);
+  return bvec;
+}
+
+static uint64_t c_linemap_hash(const octet* data, size_t len) {
+  uint64_t h = 0xcbf29ce484222325ull; /* FNV-1a */
+  size_t   i;
+  for (i = 0; i < len; i++) {
+    h = (h ^ data[i]) * 0x100000001b3ull;
+  }
+  return h;
+}
+
+/**
+ * set keep[i] = 1 if i-th line of linemap is the last occurrence of its content,
+ * otherwise set keep[i] = 0.
+ * return the number of lines that occur again later, or -1 if out of memory.
+ */
+static int64_t c_linemap_dedup(const s_linemap* lm, uint8_t* keep) {
+  uint32_t* table; /* open addressing hash table of line indexes + 1, 0 means empty */
+  size_t    cap = 16, mask;
+  int64_t   dup = 0;
+  uint32_t  i;
+  while (cap < (size_t)lm->count * 2) {
+    cap *= 2;
+  }
+  mask  = cap - 1;
+  table = calloc(cap, sizeof(uint32_t));
+  if (table == NULL) {
+    return -1;
+  }
+  for (i = lm->count; i-- != 0;) {
+    const octet* line = lm->addr + lm->offsets[i];
+    uint32_t     len  = lm->offsets[i + 1] - 1 - lm->offsets[i];
+    size_t       slot = (size_t)c_linemap_hash(line, len) & mask;
+    keep[i]           = 1;
+    for (; table[slot] != 0; slot = (slot + 1) & mask) {
+      uint32_t j     = table[slot] - 1;
+      uint32_t len_j = lm->offsets[j + 1] - 1 - lm->offsets[j];
+      if (len_j == len && memcmp(line, lm->addr + lm->offsets[j], len) == 0) {
+        keep[i] = 0;
+        dup++;
+        break;
+      }
+    }
+    if (keep[i]) {
+      table[slot] = i + 1;
+    }
+  }
+  free(table);
+  return dup;
+}
+
+/** return the number of lines in linemap that occur again later, or c_errno() on error */
+static iptr c_linemap_duplicates(uptr handle) {
+  s_linemap* lm = (s_linemap*)handle;
+  uint8_t*   keep;
+  int64_t    dup;
+  if (lm == NULL) {
+    return c_errno_set(EINVAL);
+  }
+  if ((keep = malloc(lm->count + 1)) == NULL) {
+    return c_errno_set(ENOMEM);
+  }
+  dup = c_linemap_dedup(lm, keep);
+  free(keep);
+  return dup >= 0 ? (iptr)dup : c_errno_set(ENOMEM);
+}
+
+/** write all len bytes to fd, retrying on EINTR and short writes. return 0 on success, or c_errno() on error */
+static int c_linemap_write_all(int fd, const octet* data, size_t len) {
+  while (len != 0) {
+    ssize_t n = write(fd, data, len);
+    if (n >= 0) {
+      data += n;
+      len -= (size_t)n;
+    } else if (errno != EINTR) {
+      return c_errno();
+    }
+  }
+  return 0;
+}
+
+/**
+ * write to fd the lines of linemap, each followed by a newline,
+ * omitting the lines whose content occurs again later.
+ * return 0 on success, or c_errno() on error.
+ */
+static int c_linemap_compact(uptr handle, int fd) {
+  s_linemap* lm = (s_linemap*)handle;
+  uint8_t*   keep;
+  uint32_t   i   = 0;
+  int        err = 0;
+  if (lm == NULL) {
+    return c_errno_set(EINVAL);
+  }
+  if ((keep = malloc(lm->count + 1)) == NULL) {
+    return c_errno_set(ENOMEM);
+  }
+  if (c_linemap_dedup(lm, keep) < 0) {
+    free(keep);
+    return c_errno_set(ENOMEM);
+  }
+  while (err == 0 && i < lm->count) {
+    /* coalesce consecutive kept lines into a single write() */
+    uint32_t start, end;
+    while (i < lm->count && !keep[i]) {
+      i++;
+    }
+    if (i >= lm->count) {
+      break;
+    }
+    start = lm->offsets[i];
+    while (i < lm->count && keep[i]) {
+      i++;
+    }
+    end = lm->offsets[i];
+    if (end > lm->size) {
+      /* last line has no newline */
+      err = c_linemap_write_all(fd, lm->addr + start, lm->size - start);
+      if (err == 0) {
+        err = c_linemap_write_all(fd, (const octet*)"\n", 1);
+      }
+    } else {
+      err = c_linemap_write_all(fd, lm->addr + start, end - start);
+    }
+  }
+  free(keep);
+  return err;
+}
@@ -0,0 +1,146 @@
+/**
+ * Copyright (C) 2023-2025 by Massimiliano Ghilardi
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/** this file should be included only by posix/posix.c */
+#ifndef SCHEMESH_POSIX_POSIX_C
+#error "posix/mapfile.h should only be #included by posix/posix.c"
+#endif
+
+/* ------------------------------------ mapped file --------------------------------------------- */
+
+/*
+ * Read-only, windowed memory map of a regular file.
+ * Used by posix/io.ss to implement (file->port path 'read '(mmap) ...):
+ * each read copies directly from the mapping into a Scheme bytevector, without read() syscalls.
+ *
+ * At most one window of c_mapfile_window() bytes is mapped at any time,
+ * and it is moved when reading past its end, so files larger than the address space can be read.
+ *
+ * The file size is sampled once when opening: data appended later is not visible.
+ * The file must not be truncated while mapped, otherwise reads may raise SIGBUS.
+ */
+
+#include <sys/mman.h> /* mmap(), munmap(), madvise() */
+
+typedef struct s_mapfile {
+  const octet* addr;      /* NULL if no window is mapped */
+  uint64_t     win_start; /* file offset of addr, a multiple of c_mapfile_window() */
+  size_t       win_size;  /* number of bytes mapped at addr */
+  uint64_t     size;      /* file size in bytes */
+  int          fd;        /* not owned: caller must keep it open until c_mapfile_close() */
+} s_mapfile;
+
+/** return the maximum number of bytes mapped at any time. It is a multiple of page size */
+static size_t c_mapfile_window(void) {
+  return sizeof(void*) >= 8 ? (size_t)1 << 30 : (size_t)1 << 24;
+}
+
+/**
+ * prepare memory mapping the regular file open as fd, which must stay open until c_mapfile_close().
+ * return a Scheme integer > 0 i.e. the handle to pass to other c_mapfile_...() functions,
+ * or a Scheme integer < 0 i.e. c_errno() on error.
+ */
+static ptr c_mapfile_open(int fd) {
+  struct stat st;
+  s_mapfile*  mf;
+  if (fstat(fd, &st) < 0) {
+    return Sinteger(c_errno());
+  }
+  if (!S_ISREG(st.st_mode) || st.st_size < 0) {
+    return Sinteger(c_errno_set(ENODEV)); /* same error as mmap() on unsupported files */
+  }
+  mf = malloc(sizeof(s_mapfile));
+  if (mf == NULL) {
+    return Sinteger(c_errno_set(ENOMEM));
+  }
+  mf->addr      = NULL;
+  mf->win_start = 0;
+  mf->win_size  = 0;
+  mf->size      = (uint64_t)st.st_size;
+  mf->fd        = fd;
+  return Sunsigned((uptr)mf);
+}
+
+/** unmap and free a mapfile created by c_mapfile_open(). Does not close its fd */
+static void c_mapfile_close(uptr handle) {
+  s_mapfile* mf = (s_mapfile*)handle;
+  if (mf != NULL) {
+    if (mf->addr != NULL) {
+      (void)munmap((void*)mf->addr, mf->win_size);
+    }
+    free(mf);
+  }
+}
+
+/** return the size in bytes of a mapfile, as sampled by c_mapfile_open() */
+static int64_t c_mapfile_size(uptr handle) {
+  s_mapfile* mf = (s_mapfile*)handle;
+  return mf != NULL ? (int64_t)mf->size : 0;
+}
+
+/** map the window containing file offset pos, which must be < mf->size. return 0 or c_errno() on error */
+static int c_mapfile_remap(s_mapfile* mf, uint64_t pos) {
+  const size_t window = c_mapfile_window();
+  uint64_t     start  = pos - pos % window;
+  size_t       size   = mf->size - start < window ? (size_t)(mf->size - start) : window;
+  void*        addr;
+  if (mf->addr != NULL) {
+    (void)munmap((void*)mf->addr, mf->win_size);
+    mf->addr     = NULL;
+    mf->win_size = 0;
+  }
+  addr = mmap(NULL, size, PROT_READ, MAP_PRIVATE, mf->fd, (off_t)start);
+  if (addr == MAP_FAILED) {
+    return c_errno();
+  }
+#ifdef MADV_SEQUENTIAL
+  (void)madvise(addr, size, MADV_SEQUENTIAL); /* only a hint, ignore errors */
+#endif
+  mf->addr      = (const octet*)addr;
+  mf->win_start = start;
+  mf->win_size  = size;
+  return 0;
+}
+
+/**
+ * copy bytes of a mapfile starting at file offset pos into bytevector range [start, end),
+ * moving the mapped window as needed.
+ * return the number of bytes copied, which is zero only at end-of-file or if start == end,
+ * or c_errno() < 0 on error.
+ */
+static iptr c_mapfile_read(uptr handle, int64_t pos, ptr bvec, iptr start, iptr end) {
+  s_mapfile* mf   = (s_mapfile*)handle;
+  iptr       done = 0;
+  octet*     dst;
+  if (mf == NULL || pos < 0 || !Sbytevectorp(bvec) || start < 0 || start > end ||
+      (uptr)end > (uptr)Sbytevector_length(bvec)) {
+    return c_errno_set(EINVAL);
+  }
+  dst = Sbytevector_data(bvec) + start;
+  while (done < end - start && (uint64_t)pos < mf->size) {
+    uint64_t off;
+    size_t   n;
+    if (mf->addr == NULL || (uint64_t)pos < mf->win_start ||
+        (uint64_t)pos - mf->win_start >= mf->win_size) {
+      int err = c_mapfile_remap(mf, (uint64_t)pos);
+      if (err < 0) {
+        return done != 0 ? done : err;
+      }
+    }
+    off = (uint64_t)pos - mf->win_start;
+    n   = mf->win_size - (size_t)off;
+    if (n > (size_t)(end - start - done)) {
+      n = (size_t)(end - start - done);
+    }
+    memcpy(dst + done, mf->addr + off, n);
+    done += (iptr)n;
+    pos += (int64_t)n;
+  }
+  return done;
+}
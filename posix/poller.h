@@ -0,0 +1,371 @@
+/**
+ * Copyright (C) 2023-2025 by Massimiliano Ghilardi
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/** this file should be included only by posix/posix.c */
+#ifndef SCHEMESH_POSIX_POSIX_C
+#error "posix/poller.h should only be #included by posix/posix.c"
+#endif
+
+/* ------------------------------------ fd poller ----------------------------------------------- */
+
+/*
+ * Wait for readiness of many file descriptors with a single blocking call.
+ *
+ * Uses epoll on Linux, kqueue on BSD and macOS, and falls back on poll() elsewhere
+ * or if SCHEMESH_POLLER_USE_POLL is defined.
+ *
+ * A poller remembers the registered file descriptors and their rw_mask
+ * in a sorted array, needed by all backends:
+ *   epoll needs to know whether to call EPOLL_CTL_ADD or EPOLL_CTL_MOD - and retries with the other one
+ *     if fd was closed without unregistering it, and its number was reused,
+ *   kqueue needs to know which filters to delete,
+ *   poll() needs the whole list at each call.
+ *
+ * A poller is not thread-safe: it must not be accessed by multiple threads at the same time.
+ */
+
+#if defined(SCHEMESH_POLLER_USE_POLL)
+#define SCHEMESH_POLLER_POLL
+#elif defined(__linux__)
+#define SCHEMESH_POLLER_EPOLL
+#include <sys/epoll.h> /* epoll_create1(), epoll_ctl(), epoll_wait() */
+#elif defined(SCHEMESH_HAVE_KQUEUE)
+#define SCHEMESH_POLLER_KQUEUE
+#else
+#define SCHEMESH_POLLER_POLL
+#endif
+
+typedef struct s_poller_fd {
+  int fd;
+  int rw_mask;    /* registered interest: combination of mask_READ and mask_WRITE */
+  int ready_mask; /* used only by c_poller_wait(): readiness reported by the OS */
+} s_poller_fd;
+
+typedef struct s_poller {
+  int          backend_fd; /* epoll or kqueue file descriptor, or -1 if using poll() */
+  s_poller_fd* fds;        /* registered file descriptors, sorted by fd */
+  size_t       fd_n, fd_cap;
+  size_t*      ready;      /* indexes in fds[] of file descriptors reported as ready */
+  size_t       ready_n;
+#if defined(SCHEMESH_POLLER_EPOLL)
+  struct epoll_event* events; /* fd_cap elements */
+#elif defined(SCHEMESH_POLLER_KQUEUE)
+  struct kevent* events; /* 2 * fd_cap elements: one for each filter */
+#else
+  struct pollfd* events; /* fd_cap elements */
+#endif
+} s_poller;
+
+/** return index of fd in p->fds[], or index where it should be inserted if not present */
+static size_t c_poller_find(const s_poller* p, int fd) {
+  size_t lo = 0, hi = p->fd_n;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (p->fds[mid].fd < fd) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/** enlarge p->fds[], p->ready[] and p->events[] to contain at least one more element */
+static int c_poller_grow(s_poller* p) {
+  size_t       cap = p->fd_cap != 0 ? p->fd_cap * 2 : 8;
+  s_poller_fd* fds;
+  size_t*      ready;
+  void*        events;
+  if ((fds = realloc(p->fds, cap * sizeof(p->fds[0]))) == NULL) {
+    return c_errno_set(ENOMEM);
+  }
+  p->fds = fds;
+  if ((ready = realloc(p->ready, cap * sizeof(p->ready[0]))) == NULL) {
+    return c_errno_set(ENOMEM);
+  }
+  p->ready = ready;
+#if defined(SCHEMESH_POLLER_KQUEUE)
+  events = realloc(p->events, 2 * cap * sizeof(p->events[0]));
+#else
+  events = realloc(p->events, cap * sizeof(p->events[0]));
+#endif
+  if (events == NULL) {
+    return c_errno_set(ENOMEM);
+  }
+  p->events = events;
+  p->fd_cap = cap;
+  return 0;
+}
+
+/** inform the OS that interest for fd changed from old_mask to new_mask */
+static int c_poller_ctl(s_poller* p, int fd, int old_mask, int new_mask) {
+#if defined(SCHEMESH_POLLER_EPOLL)
+  struct epoll_event ev = {};
+  int                op = new_mask == 0 ? EPOLL_CTL_DEL : old_mask == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+  ev.events = (new_mask & mask_READ ? EPOLLIN : 0) | (new_mask & mask_WRITE ? EPOLLOUT : 0);
+  ev.data.fd = fd;
+  if (epoll_ctl(p->backend_fd, op, fd, &ev) < 0) {
+    /*
+     * our cached mask can disagree with the kernel: if fd was closed before unregistering it,
+     * the kernel already forgot it, and the same fd number may since have been reused.
+     */
+    if (op == EPOLL_CTL_DEL && (errno == EBADF || errno == ENOENT)) {
+      return 0;
+    } else if (op == EPOLL_CTL_MOD && errno == ENOENT) {
+      op = EPOLL_CTL_ADD;
+    } else if (op == EPOLL_CTL_ADD && errno == EEXIST) {
+      op = EPOLL_CTL_MOD;
+    } else {
+      return c_errno();
+    }
+    if (epoll_ctl(p->backend_fd, op, fd, &ev) < 0) {
+      return c_errno();
+    }
+  }
+  return 0;
+#elif defined(SCHEMESH_POLLER_KQUEUE)
+  struct kevent changes[2];
+  /* if masks are equal, add the filters again: fd may have been closed and its number reused */
+  const int diff = old_mask != new_mask ? old_mask ^ new_mask : new_mask;
+  int       i, n = 0;
+  if (diff & mask_READ) {
+    EV_SET(&changes[n++], fd, EVFILT_READ, new_mask & mask_READ ? EV_ADD : EV_DELETE, 0, 0, NULL);
+  }
+  if (diff & mask_WRITE) {
+    EV_SET(&changes[n++], fd, EVFILT_WRITE, new_mask & mask_WRITE ? EV_ADD : EV_DELETE, 0, 0, NULL);
+  }
+  /*
+   * apply changes one by one: EV_ADD also modifies an existing filter, and EV_DELETE fails
+   * if fd was closed before unregistering it, because the kernel already forgot its filters
+   */
+  for (i = 0; i < n; i++) {
+    if (kevent(p->backend_fd, &changes[i], 1, NULL, 0, NULL) < 0 &&
+        !(changes[i].flags == EV_DELETE && (errno == EBADF || errno == ENOENT))) {
+      return c_errno();
+    }
+  }
+  return 0;
+#else
+  (void)p;
+  (void)fd;
+  (void)old_mask;
+  (void)new_mask;
+  return 0;
+#endif
+}
+
+/**
+ * create a poller.
+ * return a Scheme integer > 0 i.e. the handle to pass to other c_poller_...() functions,
+ * or a Scheme integer < 0 i.e. c_errno() on error.
+ */
+static ptr c_poller_open(void) {
+  s_poller* p = calloc(1, sizeof(s_poller));
+  if (p == NULL) {
+    return Sinteger(c_errno_set(ENOMEM));
+  }
+#if defined(SCHEMESH_POLLER_EPOLL)
+  p->backend_fd = epoll_create1(EPOLL_CLOEXEC);
+#elif defined(SCHEMESH_POLLER_KQUEUE)
+  if ((p->backend_fd = kqueue()) >= 0) {
+    (void)fcntl(p->backend_fd, F_SETFD, FD_CLOEXEC);
+  }
+#else
+  p->backend_fd = -1;
+#endif
+#if !defined(SCHEMESH_POLLER_POLL)
+  if (p->backend_fd < 0) {
+    int err = c_errno();
+    free(p);
+    return Sinteger(err);
+  }
+#endif
+  return Sunsigned((uptr)p);
+}
+
+/** release all resources of a poller created with c_poller_open() */
+static void c_poller_close(uptr handle) {
+  s_poller* p = (s_poller*)handle;
+  if (p == NULL) {
+    return;
+  }
+  if (p->backend_fd >= 0) {
+    (void)close(p->backend_fd);
+  }
+  free(p->fds);
+  free(p->ready);
+  free(p->events);
+  free(p);
+}
+
+/** forget the file descriptors reported as ready by the last call to c_poller_wait() */
+static void c_poller_forget_ready(s_poller* p) {
+  size_t i;
+  for (i = 0; i < p->ready_n; i++) {
+    p->fds[p->ready[i]].ready_mask = 0;
+  }
+  p->ready_n = 0;
+}
+
+/**
+ * register interest for file descriptor fd becoming ready for reading and/or writing.
+ * rw_mask must be a combination of mask_READ and mask_WRITE, or 0 to unregister fd.
+ * return 0 on success, or c_errno() on error.
+ */
+static int c_poller_set(uptr handle, int fd, int rw_mask) {
+  s_poller* p = (s_poller*)handle;
+  size_t    i;
+  int       old_mask;
+  int       err;
+  if (p == NULL || fd < 0) {
+    return c_errno_set(EINVAL);
+  }
+  rw_mask &= mask_READ | mask_WRITE;
+  i        = c_poller_find(p, fd);
+  old_mask = i < p->fd_n && p->fds[i].fd == fd ? p->fds[i].rw_mask : 0;
+  if (old_mask == rw_mask) {
+    /* fd may have been closed and its number reused: register it again with the kernel */
+    return rw_mask == 0 ? 0 : c_poller_ctl(p, fd, old_mask, rw_mask);
+  }
+  if (old_mask == 0 && p->fd_n == p->fd_cap && (err = c_poller_grow(p)) < 0) {
+    return err;
+  }
+  if ((err = c_poller_ctl(p, fd, old_mask, rw_mask)) < 0) {
+    return err;
+  }
+  /* inserting or removing elements in p->fds[] invalidates the indexes in p->ready[] */
+  c_poller_forget_ready(p);
+  if (rw_mask == 0) {
+    memmove(p->fds + i, p->fds + i + 1, (p->fd_n - i - 1) * sizeof(p->fds[0]));
+    p->fd_n--;
+  } else if (old_mask == 0) {
+    memmove(p->fds + i + 1, p->fds + i, (p->fd_n - i) * sizeof(p->fds[0]));
+    p->fds[i].fd         = fd;
+    p->fds[i].rw_mask    = rw_mask;
+    p->fds[i].ready_mask = 0;
+    p->fd_n++;
+  } else {
+    p->fds[i].rw_mask = rw_mask;
+  }
+  return 0;
+}
+
+/** record that fd is ready: add ready_mask to its p->fds[] entry */
+static void c_poller_mark_ready(s_poller* p, int fd, int ready_mask) {
+  size_t i = c_poller_find(p, fd);
+  if (ready_mask == 0 || i >= p->fd_n || p->fds[i].fd != fd) {
+    return;
+  }
+  if (p->fds[i].ready_mask == 0) {
+    p->ready[p->ready_n++] = i;
+  }
+  p->fds[i].ready_mask |= ready_mask;
+}
+
+/**
+ * wait up to timeout_milliseconds for at least one registered file descriptor to become ready.
+ * timeout_milliseconds < 0 means infinite timeout.
+ *
+ * Does not access Scheme objects, thus it can be called as __collect_safe.
+ *
+ * return the number of ready file descriptors, which are retrieved by calling c_poller_ready(),
+ * or c_errno() on error. Does NOT retry on EINTR, returns it instead.
+ */
+static int c_poller_wait(uptr handle, int timeout_milliseconds) {
+  s_poller* p = (s_poller*)handle;
+  int       i, n;
+  if (p == NULL) {
+    return c_errno_set(EINVAL);
+  }
+  c_poller_forget_ready(p);
+#if defined(SCHEMESH_POLLER_EPOLL)
+  if (p->fd_n == 0) {
+    n = poll(NULL, 0, timeout_milliseconds); /* epoll_wait() rejects maxevents == 0 */
+  } else {
+    n = epoll_wait(p->backend_fd, p->events, (int)p->fd_n, timeout_milliseconds);
+  }
+  if (n < 0) {
+    return c_errno();
+  }
+  for (i = 0; i < n; i++) {
+    const uint32_t events = p->events[i].events;
+    c_poller_mark_ready(p,
+                        p->events[i].data.fd,
+                        (events & (EPOLLIN | EPOLLHUP) ? mask_READ : 0) |  /*           */
+                            (events & EPOLLOUT ? mask_WRITE : 0) |         /*           */
+                            (events & EPOLLERR ? mask_ERR : 0));
+  }
+#elif defined(SCHEMESH_POLLER_KQUEUE)
+  {
+    struct timespec  ts;
+    struct timespec* pts = NULL;
+    if (timeout_milliseconds >= 0) {
+      ts.tv_sec  = timeout_milliseconds / 1000;
+      ts.tv_nsec = (long)(timeout_milliseconds % 1000) * 1000000;
+      pts        = &ts;
+    }
+    n = kevent(p->backend_fd, NULL, 0, p->events, (int)(2 * p->fd_n), pts);
+  }
+  if (n < 0) {
+    return c_errno();
+  }
+  for (i = 0; i < n; i++) {
+    const struct kevent* ev = &p->events[i];
+    c_poller_mark_ready(p,
+                        (int)ev->ident,
+                        (ev->filter == EVFILT_READ ? mask_READ : 0) |     /*            */
+                            (ev->filter == EVFILT_WRITE ? mask_WRITE : 0) | /*          */
+                            (ev->flags & EV_ERROR ? mask_ERR : 0));
+  }
+#else
+  for (i = 0; (size_t)i < p->fd_n; i++) {
+    struct pollfd* ev = &p->events[i];
+    ev->fd            = p->fds[i].fd;
+    ev->events        = (p->fds[i].rw_mask & mask_READ ? POLLIN : 0) | /*                    */
+                 (p->fds[i].rw_mask & mask_WRITE ? POLLOUT : 0);
+    ev->revents = 0;
+  }
+  if ((n = poll(p->events, (nfds_t)p->fd_n, timeout_milliseconds)) < 0) {
+    return c_errno();
+  }
+  for (i = 0; n > 0 && (size_t)i < p->fd_n; i++) {
+    const int revents = p->events[i].revents;
+    if (revents != 0) {
+      c_poller_mark_ready(p,
+                          p->events[i].fd,
+                          (revents & (POLLIN | POLLHUP) ? mask_READ : 0) | /*           */
+                              (revents & POLLOUT ? mask_WRITE : 0) |       /*           */
+                              (revents & (POLLERR | POLLNVAL) ? mask_ERR : 0));
+      n--;
+    }
+  }
+#endif
+  return (int)p->ready_n;
+}
+
+/**
+ * return a Scheme list of pairs (fd . ready_mask) containing the file descriptors
+ * reported as ready by the last call to c_poller_wait(),
+ * where ready_mask is a combination of mask_READ, mask_WRITE and mask_ERR.
+ */
+static ptr c_poller_ready(uptr handle) {
+  s_poller* p   = (s_poller*)handle;
+  ptr       ret = Snil;
+  size_t    i;
+  if (p == NULL) {
+    return ret;
+  }
+  for (i = p->ready_n; i > 0; i--) {
+    s_poller_fd* entry = &p->fds[p->ready[i - 1]];
+    ret                = Scons(Scons(Sfixnum(entry->fd), Sfixnum(entry->ready_mask)), ret);
+    entry->ready_mask  = 0;
+  }
+  p->ready_n = 0;
+  return ret;
+}
@@ -28,6 +28,7 @@
 #include <pwd.h>     /* getpwnam_r(), getpwuid_r() */
 #include <sched.h>   /* sched_yield() */
 #include <signal.h>  /* kill(), sigaction(), SIG... */
+#include <spawn.h>   /* posix_spawn(), posix_spawnp() */
 #include <stdatomic.h>
 #include <stddef.h>     /* size_t, NULL */
 #include <stdint.h>     /* int64_t */
@@ -35,6 +36,7 @@
 #include <stdlib.h>     /* getenv(), strtoul() */
 #include <string.h>     /* strlen(), strerror() */
 #include <sys/ioctl.h>  /* ioctl(), TIOCGWINSZ */
+#include <sys/resource.h> /* struct rusage */
 #include <sys/socket.h> /* socketpair(), AF_UNIX, SOCK_STREAM */
 #include <sys/stat.h>   /* fstatat() */
 #include <sys/types.h>
@@ -48,6 +50,38 @@
 #undef SCHEMESH_USE_TTY_IOCTL
 #endif
 
+#ifdef __linux__
+#include <sys/syscall.h> /* SYS_pidfd_open */
+#endif
+
+#if defined(__APPLE__) || defined(__DragonFly__) || defined(__FreeBSD__) ||                    \
+    defined(__NetBSD__) || defined(__OpenBSD__)
+#define SCHEMESH_HAVE_KQUEUE
+#include <sys/event.h> /* kqueue(), kevent(), EVFILT_PROC */
+#endif
+
+#ifndef SCHEMESH_NO_POSIX_SPAWN
+/* spawn external programs with posix_spawn() instead of fork() + exec() whenever possible */
+#define SCHEMESH_USE_POSIX_SPAWN
+#endif
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+#define SCHEMESH_HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR_NP
+#ifndef __USE_GNU
+/* declared by <spawn.h> only if _GNU_SOURCE is defined */
+extern int posix_spawn_file_actions_addchdir_np(posix_spawn_file_actions_t* actions,
+                                                const char*                 path);
+#endif
+#else
+#undef SCHEMESH_HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR_NP
+#endif
+
+#if defined(__linux__) && !defined(F_SETPIPE_SZ)
+/* declared by <fcntl.h> only if _GNU_SOURCE is defined */
+#define F_SETPIPE_SZ 1031
+#define F_GETPIPE_SZ 1032
+#endif
+
 #ifdef SCHEMESH_USE_TTY_IOCTL
 #include <asm/termbits.h> /* struct termios, incompatible with <termios.h> */
 #else
@@ -64,6 +98,10 @@ static int c_init_failed(const char label[]);
 /** signal.h defines a lot of static functions */
 #include "signal.h"
 
+#include "glob.h"
+#include "linemap.h"
+#include "mapfile.h"
+
 static int c_fd_open_max(void);
 static int c_job_control_available(void);
 
@@ -105,6 +143,10 @@ static int c_errno_enotdir(void) {
   return -ENOTDIR;
 }
 
+static int c_errno_epipe(void) {
+  return -EPIPE;
+}
+
 static int c_errno_esrch(void) {
   return -ESRCH;
 }
@@ -719,6 +761,10 @@ enum read_write_mask {
   mask_ERR   = 4,
 };
 
+/** poller.h and shmring.h need enum read_write_mask */
+#include "poller.h"
+#include "shmring.h"
+
 /**
  * call select() or poll() on file descriptor.
  * Returns rw_mask of operations available on file descriptor,
@@ -778,8 +824,16 @@ static int c_open_file_fd(ptr bytevector0_filepath,
   return ret >= 0 ? ret : c_errno();
 }
 
-/** call pipe() and return a Scheme cons (pipe_read_fd . pipe_write_fd), or c_errno() on error */
-static ptr c_open_pipe_fds(ptr read_fd_close_on_exec, ptr write_fd_close_on_exec) {
+/**
+ * call pipe() and return a Scheme cons (pipe_read_fd . pipe_write_fd), or c_errno() on error.
+ * If capacity > 0 and the OS supports it, also try to enlarge the pipe buffer to capacity bytes:
+ * failing to do so is not an error, the pipe just keeps its default capacity.
+ *
+ * On Linux, enlarging is skipped if the new pipe only got a single page of buffer:
+ * it means the pipes of current user already exceed the per-user soft limit
+ * /proc/sys/fs/pipe-user-pages-soft, and enlarging more pipes would only worsen that.
+ */
+static ptr c_open_pipe_fds(ptr read_fd_close_on_exec, ptr write_fd_close_on_exec, int capacity) {
   int fds[2];
   int err = pipe(fds);
   if (err < 0) {
@@ -791,6 +845,16 @@ static ptr c_open_pipe_fds(ptr read_fd_close_on_exec, ptr write_fd_close_on_exec
   if (err == 0 && write_fd_close_on_exec != Sfalse) {
     err = fcntl(fds[1], F_SETFD, FD_CLOEXEC);
   }
+#if defined(F_SETPIPE_SZ) && defined(F_GETPIPE_SZ)
+  if (err == 0 && capacity > 0) {
+    const int current = fcntl(fds[1], F_GETPIPE_SZ);
+    if (current > 0 && current < capacity && current > (int)sysconf(_SC_PAGESIZE)) {
+      (void)fcntl(fds[1], F_SETPIPE_SZ, capacity);
+    }
+  }
+#else
+  (void)capacity;
+#endif
   if (err == 0) {
     return Scons(Sinteger(fds[0]), Sinteger(fds[1]));
   }
@@ -800,6 +864,65 @@ static ptr c_open_pipe_fds(ptr read_fd_close_on_exec, ptr write_fd_close_on_exec
   return Sinteger(err);
 }
 
+/**
+ * return the capacity in bytes of the pipe buffer of fd, or c_errno() on error.
+ * return c_errno_set(ENOTSUP) if the OS does not support querying it.
+ */
+static int c_fd_pipe_capacity(int fd) {
+#ifdef F_GETPIPE_SZ
+  int ret = fcntl(fd, F_GETPIPE_SZ);
+  return ret >= 0 ? ret : c_errno();
+#else
+  (void)fd;
+  return c_errno_set(ENOTSUP);
+#endif
+}
+
+/**
+ * create an anonymous, readable and writable file that lives in memory if the OS supports it,
+ * and return its file descriptor, or c_errno() on error.
+ * On Linux uses memfd_create(), elsewhere creates and immediately deletes a temporary file.
+ */
+static int c_open_memory_fd(ptr close_on_exec) {
+  int fd;
+#if defined(__linux__) && defined(SYS_memfd_create)
+  fd = (int)syscall(SYS_memfd_create, "schemesh-capture", close_on_exec != Sfalse ? 1 : 0);
+  if (fd >= 0) {
+    return fd;
+  }
+  /* fall back on a temporary file, for example if kernel is older than 3.17 */
+#endif
+  {
+    const char* dir = getenv("TMPDIR");
+    size_t      len;
+    char*       path;
+    if (dir == NULL || dir[0] == '\0') {
+      dir = "/tmp";
+    }
+    len  = strlen(dir);
+    path = (char*)malloc(len + 25);
+    if (!path) {
+      return c_errno_set(ENOMEM);
+    }
+    memcpy(path, dir, len);
+    memcpy(path + len, "/schemesh-capture-XXXXXX", 25);
+    fd = mkstemp(path);
+    if (fd >= 0) {
+      (void)unlink(path);
+    }
+    free(path);
+  }
+  if (fd < 0) {
+    return c_errno();
+  }
+  if (close_on_exec != Sfalse && fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+    int err = c_errno();
+    (void)close(fd);
+    return err;
+  }
+  return fd;
+}
+
 /**
  * call socketpair(AF_UNIX, SOCK_STREAM) and return a Scheme cons (socket1_fd . socket2_fd),
  * or c_errno() on error
@@ -1265,13 +1388,13 @@ static ptr c_dirent_type(unsigned char d_type) {
  * if keep_symlinks == 0, resolves symlinks i.e. calls fstatat()
  * to resolve DT_LNK and DT_UNKNOWN to the type of the file pointed to.
  */
-static ptr c_dirent_type2(DIR*                dir,
+static ptr c_dirent_type2(int                 dir_fd,
                           const char*         filename,
                           const int           keep_symlinks,
                           const unsigned char d_type) {
   if (keep_symlinks == 0 && (d_type == DT_LNK || d_type == DT_UNKNOWN)) {
     struct stat buf;
-    if (fstatat(dirfd(dir), filename, &buf, 0) == 0) {
+    if (fstatat(dir_fd, filename, &buf, 0) == 0) {
       return c_stat_type(buf.st_mode & S_IFMT);
     }
   }
@@ -1316,21 +1439,179 @@ static ptr c_file_type(ptr bytevector0_path, int keep_symlinks) {
   return Sinteger(-err);
 }
 
+/**
+ * Return the last modification time of a filesystem path, resolving symlinks.
+ * bytevector0_path must be a 0-terminated bytevector.
+ *
+ * If file exists, return a Scheme pair (seconds . nanoseconds)
+ * Returns #f if file does not exist.
+ *
+ * On other errors, return Scheme integer -errno
+ */
+static ptr c_file_mtime(ptr bytevector0_path) {
+  struct stat buf;
+  const char* path;
+  iptr        pathlen;
+  int         err;
+  if (!Sbytevectorp(bytevector0_path)) {
+    return Sinteger(c_errno_set(EINVAL));
+  }
+  path    = (const char*)Sbytevector_data(bytevector0_path);
+  pathlen = Sbytevector_length(bytevector0_path); /* including final '\0' */
+  if (pathlen <= 0 || path[pathlen - 1] != '\0') {
+    return Sinteger(c_errno_set(EINVAL));
+  }
+  if (stat(path, &buf) == 0) {
+#ifdef __APPLE__
+    const long nsec = (long)buf.st_mtimespec.tv_nsec;
+#else
+    const long nsec = (long)buf.st_mtim.tv_nsec;
+#endif
+    return Scons(Sinteger64((int64_t)buf.st_mtime), Sfixnum(nsec));
+  }
+  err = errno;
+  if (err == ENOENT || err == ENOTDIR) {
+    errno = 0;
+    return Sfalse;
+  }
+  return Sinteger(-err);
+}
+
 typedef enum { o_symlinks = 1, o_append_slash = 2, o_bytes = 4, o_types = 8 } o_dir_options;
 
 typedef struct {
-  const char* prefix;
-  const char* suffix;
-  iptr        prefixlen;
-  iptr        suffixlen;
-  char        prefix_has_slash;
-  char        suffix_has_slash;
-  char        keep_symlinks;
-  char        ret_append_slash;
-  char        ret_bytes;
-  char        ret_types;
+  const char*       prefix;
+  const char*       suffix;
+  const s_glob_seg* pattern;       /* NULL if no pattern was specified */
+  void*             pattern_arena; /* allocation that contains pattern, free it with free() */
+  iptr              prefixlen;
+  iptr              suffixlen;
+  char              prefix_has_slash;
+  char              suffix_has_slash;
+  char              keep_symlinks;
+  char              ret_append_slash;
+  char              ret_bytes;
+  char              ret_types;
 } s_directory_list_opts;
 
+/**
+ * fill opts from the arguments of c_directory_list() or c_directory_read().
+ * return 0 if successful: caller must then call c_directory_list_opts_free(),
+ * or 1 if the filters cannot be satisfied by any filename,
+ * or c_errno_set(EINVAL) < 0 if some argument is invalid.
+ */
+static int c_directory_list_opts_init(s_directory_list_opts* opts,
+                                      ptr                    bytevector_filter_prefix,
+                                      ptr                    bytevector_filter_suffix,
+                                      ptr                    vector_filter_pattern,
+                                      int                    options) {
+  opts->pattern       = NULL;
+  opts->pattern_arena = NULL;
+  if (!Sbytevectorp(bytevector_filter_prefix) || !Sbytevectorp(bytevector_filter_suffix) ||
+      (vector_filter_pattern != Sfalse && !Svectorp(vector_filter_pattern))) {
+    return c_errno_set(EINVAL);
+  }
+  opts->prefix    = (const char*)Sbytevector_data(bytevector_filter_prefix);
+  opts->prefixlen = Sbytevector_length(bytevector_filter_prefix);
+  opts->suffix    = (const char*)Sbytevector_data(bytevector_filter_suffix);
+  opts->suffixlen = Sbytevector_length(bytevector_filter_suffix);
+  if (opts->prefixlen < 0 || opts->suffixlen < 0) {
+    return c_errno_set(EINVAL);
+  }
+  if (opts->prefixlen && opts->prefix[opts->prefixlen - 1] == '/') {
+    opts->prefix_has_slash = 1;
+    opts->prefixlen--;
+  } else {
+    opts->prefix_has_slash = 0;
+  }
+  if (opts->suffixlen && opts->suffix[opts->suffixlen - 1] == '/') {
+    opts->suffix_has_slash = 1;
+    opts->suffixlen--;
+  } else {
+    opts->suffix_has_slash = 0;
+  }
+  opts->keep_symlinks    = (options & o_symlinks) != 0;
+  opts->ret_append_slash = (options & o_append_slash) != 0;
+  opts->ret_bytes        = (options & o_bytes) != 0;
+  opts->ret_types        = (options & o_types) != 0;
+
+  if (!opts->ret_append_slash && (opts->prefix_has_slash || opts->suffix_has_slash)) {
+    return 1; /* impossible to satisfy */
+  }
+  if (vector_filter_pattern != Sfalse) {
+    /* a vector #(flags op ...) as created by (sh-pattern->c-glob): parse it as a single segment */
+    ptr         vector_segments = Smake_vector(1, vector_filter_pattern);
+    s_glob_seg* segs;
+    size_t      seg_n;
+    void*       arena;
+    int         err = c_glob_parse(vector_segments, &arena, &segs, &seg_n);
+    if (err < 0) {
+      return err;
+    }
+    if (seg_n != 1 || segs[0].ops == NULL) {
+      free(arena);
+      return c_errno_set(EINVAL);
+    }
+    opts->pattern       = &segs[0];
+    opts->pattern_arena = arena;
+  }
+  return 0;
+}
+
+/** release memory allocated by c_directory_list_opts_init() */
+static void c_directory_list_opts_free(s_directory_list_opts* opts) {
+  free(opts->pattern_arena);
+  opts->pattern       = NULL;
+  opts->pattern_arena = NULL;
+}
+
+/**
+ * check whether directory entry name matches opts.
+ * return its type i.e. a Scheme integer corresponding to enum e_type, or Sfalse if it does not match.
+ * if it matches, also set *append_slash to 1 if '/' should be appended to name, otherwise to 0.
+ */
+static ptr c_directory_match(int                          dir_fd,
+                             const char*                  name,
+                             const size_t                 namelen,
+                             const unsigned char          d_type,
+                             const s_directory_list_opts* opts,
+                             int*                         append_slash) {
+  ptr type;
+  if (opts->prefix_has_slash && namelen != (size_t)opts->prefixlen) {
+    /*
+     * prefix was specified and it ends with '/'
+     * => only names containing exactly prefixlen bytes may end with a '/'
+     * at the requested position (happens if they are directories)
+     */
+    return Sfalse;
+  }
+  if (opts->prefixlen &&
+      (namelen < (size_t)opts->prefixlen || memcmp(name, opts->prefix, opts->prefixlen) != 0)) {
+    return Sfalse; /* name does not start with prefix, ignore it */
+  }
+  if (opts->suffixlen &&
+      (namelen < (size_t)opts->suffixlen ||
+       memcmp(name + namelen - opts->suffixlen, opts->suffix, opts->suffixlen) != 0)) {
+    return Sfalse; /* name does not end with suffix, ignore it */
+  }
+  if (opts->pattern && !c_glob_match(opts->pattern, name, namelen)) {
+    return Sfalse; /* name does not match pattern, ignore it */
+  }
+  type = c_dirent_type2(dir_fd, name, opts->keep_symlinks, d_type);
+  if (opts->pattern && (opts->pattern->flags & g_dir) && type != Sfixnum(e_dir)) {
+    return Sfalse; /* pattern ends with '/' and only matches directories */
+  }
+  *append_slash = type == Sfixnum(e_dir) && opts->ret_append_slash;
+  if (!*append_slash && (opts->prefix_has_slash || opts->suffix_has_slash)) {
+    return Sfalse; /* we must only return names that end with '/' */
+  }
+  /*
+   * if *append_slash is set, we relax filter: return name even if suffix does not end with '/'
+   * because we want (sh-pattern '*) to list all files
+   */
+  return type;
+}
+
 static ptr
 c_directory_list1(DIR* dir, struct dirent* entry, const s_directory_list_opts* opts, ptr ret);
 
@@ -1356,62 +1637,51 @@ c_directory_list1(DIR* dir, struct dirent* entry, const s_directory_list_opts* o
  * If bytevector_filter_suffix is not empty,
  * only returns filenames that end with bytevector_filter_suffix.
  *
+ * If vector_filter_pattern is not #f, it must be a vector #(flags op ...) created by (sh-pattern->c-glob)
+ * and only filenames matched by such pattern are returned - see posix/glob.h for details.
+ *
  * on error, return Scheme integer -errno
  */
 static ptr c_directory_list(ptr bytevector0_dirpath,
                             ptr bytevector_filter_prefix,
                             ptr bytevector_filter_suffix,
+                            ptr vector_filter_pattern,
                             int options) {
   ptr            ret = Snil;
   const char*    dirpath;
   iptr           dirlen;
   DIR*           dir;
   struct dirent* entry;
+  int            err;
 
   s_directory_list_opts opts;
 
-  if (!Sbytevectorp(bytevector0_dirpath)         /*                 */
-      || !Sbytevectorp(bytevector_filter_prefix) /*                 */
-      || !Sbytevectorp(bytevector_filter_suffix)) {
+  if (!Sbytevectorp(bytevector0_dirpath)) {
     return Sinteger(c_errno_set(EINVAL));
   }
-  dirpath        = (const char*)Sbytevector_data(bytevector0_dirpath);
-  dirlen         = Sbytevector_length(bytevector0_dirpath); /* including final '\0' */
-  opts.prefix    = (const char*)Sbytevector_data(bytevector_filter_prefix);
-  opts.prefixlen = Sbytevector_length(bytevector_filter_prefix);
-  opts.suffix    = (const char*)Sbytevector_data(bytevector_filter_suffix);
-  opts.suffixlen = Sbytevector_length(bytevector_filter_suffix);
-  if (opts.prefixlen < 0 || opts.suffixlen < 0 || dirlen <= 0 || dirpath[dirlen - 1] != '\0') {
+  dirpath = (const char*)Sbytevector_data(bytevector0_dirpath);
+  dirlen  = Sbytevector_length(bytevector0_dirpath); /* including final '\0' */
+  if (dirlen <= 0 || dirpath[dirlen - 1] != '\0') {
     return Sinteger(c_errno_set(EINVAL));
   }
-  if (opts.prefixlen && opts.prefix[opts.prefixlen - 1] == '/') {
-    opts.prefix_has_slash = 1;
-    opts.prefixlen--;
-  } else {
-    opts.prefix_has_slash = 0;
-  }
-  if (opts.suffixlen && opts.suffix[opts.suffixlen - 1] == '/') {
-    opts.suffix_has_slash = 1;
-    opts.suffixlen--;
-  } else {
-    opts.suffix_has_slash = 0;
-  }
-  opts.keep_symlinks    = (options & o_symlinks) != 0;
-  opts.ret_append_slash = (options & o_append_slash) != 0;
-  opts.ret_bytes        = (options & o_bytes) != 0;
-  opts.ret_types        = (options & o_types) != 0;
-
-  if (!opts.ret_append_slash && (opts.prefix_has_slash || opts.suffix_has_slash)) {
+  err = c_directory_list_opts_init(
+      &opts, bytevector_filter_prefix, bytevector_filter_suffix, vector_filter_pattern, options);
+  if (err < 0) {
+    return Sinteger(err);
+  } else if (err > 0) {
     return ret; /* impossible to satisfy, return nil */
   }
   dir = opendir(dirpath);
   if (!dir) {
-    return Sinteger(c_errno());
+    err = c_errno();
+    c_directory_list_opts_free(&opts);
+    return Sinteger(err);
   }
   while ((entry = readdir(dir)) != NULL) {
     ret = c_directory_list1(dir, entry, &opts, ret);
   }
   (void)closedir(dir);
+  c_directory_list_opts_free(&opts);
   return ret;
 }
 
@@ -1422,48 +1692,247 @@ static ptr c_directory_list(ptr bytevector0_dirpath,
 static ptr
 c_directory_list1(DIR* dir, struct dirent* entry, const s_directory_list_opts* opts, ptr ret) {
 
-  char*  name    = entry->d_name;
-  size_t namelen = strlen(name);
-  ptr    type;
-  ptr    filename;
-  int    name_has_slash;
+  const char* name    = entry->d_name;
+  size_t      namelen = strlen(name);
+  ptr         type;
+  ptr         filename;
+  int         append_slash;
 
-  if (opts->prefix_has_slash && namelen != (size_t)opts->prefixlen) {
-    /*
-     * prefix was specified and it ends with '/'
-     * => only names containing exactly prefixlen bytes may end with a '/'
-     * at the requested position (happens if they are directories)
-     */
+  type = c_directory_match(dirfd(dir), name, namelen, entry->d_type, opts, &append_slash);
+  if (type == Sfalse) {
     return ret;
   }
-  if (opts->prefixlen &&
-      (namelen < (size_t)opts->prefixlen || memcmp(name, opts->prefix, opts->prefixlen) != 0)) {
-    return ret; /* name does not start with prefix, ignore it */
+  if (opts->ret_bytes) {
+    filename = Smake_bytevector(namelen + append_slash, '/');
+    memcpy(Sbytevector_data(filename), name, namelen);
+  } else if (append_slash) {
+    /* convert a copy of name followed by '/', instead of modifying entry->d_name */
+    char  buf[256];
+    char* tmp = namelen < sizeof(buf) ? buf : (char*)malloc(namelen + 1);
+    if (!tmp) {
+      return ret;
+    }
+    memcpy(tmp, name, namelen);
+    tmp[namelen] = '/';
+    filename     = schemesh_Sstring_utf8b(tmp, namelen + 1);
+    if (tmp != buf) {
+      free(tmp);
+    }
+  } else {
+    filename = schemesh_Sstring_utf8b(name, namelen);
   }
-  if (opts->suffixlen &&
-      (namelen < (size_t)opts->suffixlen ||
-       memcmp(name + namelen - opts->suffixlen, opts->suffix, opts->suffixlen) != 0)) {
-    return ret; /* name does not end with suffix, ignore it */
+  return Scons(opts->ret_types ? Scons(filename, type) : filename, ret);
+}
+
+/* ------------------------------ packed directory reader --------------------------------------- */
+
+/** growable buffers used by c_directory_read() */
+typedef struct {
+  char*          names;
+  uint32_t*      offsets;
+  unsigned char* types;
+  size_t         names_len;
+  size_t         names_cap;
+  size_t         count;
+  size_t         count_cap;
+} s_dirpack;
+
+static void c_dirpack_free(s_dirpack* pack) {
+  free(pack->names);
+  free(pack->offsets);
+  free(pack->types);
+}
+
+/**
+ * if name matches opts, append it and its type to pack.
+ * return 0 if successful, or c_errno_set(ENOMEM) or c_errno_set(EOVERFLOW) < 0 on error.
+ */
+static int c_dirpack_add(s_dirpack*                   pack,
+                         int                          dir_fd,
+                         const char*                  name,
+                         const size_t                 namelen,
+                         const unsigned char          d_type,
+                         const s_directory_list_opts* opts) {
+  int    append_slash;
+  size_t len;
+  ptr    type = c_directory_match(dir_fd, name, namelen, d_type, opts, &append_slash);
+  if (type == Sfalse) {
+    return 0;
   }
-  type           = c_dirent_type2(dir, name, opts->keep_symlinks, entry->d_type);
-  name_has_slash = type == Sfixnum(e_dir) && opts->ret_append_slash;
-  if (name_has_slash) {
-    /*
-     * relax filter: return name even if suffix does not end with '/'
-     * because we want (sh-pattern '*) to list all files
-     */
-    name[namelen++] = '/'; /* replace final '\0' -> '/' is this portable? */
-  } else if (opts->prefix_has_slash || opts->suffix_has_slash) {
-    return ret; /* we must only return names that end with '/' */
+  len = namelen + append_slash;
+  if (len > (size_t)UINT32_MAX - pack->names_len) {
+    return c_errno_set(EOVERFLOW); /* offsets are 32 bit */
   }
-  filename =
-      opts->ret_bytes ? schemesh_Sbytevector(name, namelen) : schemesh_Sstring_utf8b(name, namelen);
-  ret = Scons(opts->ret_types ? Scons(filename, type) : filename, ret);
+  if (pack->names_len + len > pack->names_cap) {
+    size_t cap   = pack->names_cap * 2 + len + 4096;
+    char*  names = (char*)realloc(pack->names, cap);
+    if (!names) {
+      return c_errno_set(ENOMEM);
+    }
+    pack->names     = names;
+    pack->names_cap = cap;
+  }
+  if (pack->count + 1 >= pack->count_cap) {
+    size_t         cap     = pack->count_cap * 2 + 256;
+    uint32_t*      offsets = (uint32_t*)realloc(pack->offsets, cap * sizeof(uint32_t));
+    unsigned char* types;
+    if (!offsets) {
+      return c_errno_set(ENOMEM);
+    }
+    pack->offsets = offsets;
+    types         = (unsigned char*)realloc(pack->types, cap);
+    if (!types) {
+      return c_errno_set(ENOMEM);
+    }
+    pack->types     = types;
+    pack->count_cap = cap;
+  }
+  memcpy(pack->names + pack->names_len, name, namelen);
+  if (append_slash) {
+    pack->names[pack->names_len + namelen] = '/';
+  }
+  pack->offsets[pack->count] = (uint32_t)pack->names_len;
+  pack->types[pack->count]   = (unsigned char)Sfixnum_value(type);
+  pack->names_len += len;
+  pack->count++;
+  return 0;
+}
 
-  if (name_has_slash) {
-    name[--namelen] = '\0'; /* restore final '\0' */
+/**
+ * read all entries of directory open as dir_fd and append the matching ones to pack.
+ * always closes dir_fd.
+ * return 0 if successful, or c_errno() < 0 on error.
+ */
+static int c_dirpack_fill(s_dirpack* pack, int dir_fd, const s_directory_list_opts* opts) {
+#if defined(__linux__) && defined(SYS_getdents64)
+  /* same layout as struct linux_dirent64, see "man 2 getdents64" */
+  struct s_dirent64 {
+    uint64_t       d_ino;
+    int64_t        d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[];
+  };
+  enum { bufsize = 256 * 1024 };
+  char* buf = (char*)malloc(bufsize);
+  long  got;
+  int   err = 0;
+  if (!buf) {
+    (void)close(dir_fd);
+    return c_errno_set(ENOMEM);
+  }
+  while (err == 0 && (got = syscall(SYS_getdents64, dir_fd, buf, (size_t)bufsize)) > 0) {
+    long pos;
+    for (pos = 0; err == 0 && pos < got;) {
+      const struct s_dirent64* entry = (const struct s_dirent64*)(buf + pos);
+      err = c_dirpack_add(pack, dir_fd, entry->d_name, strlen(entry->d_name), entry->d_type, opts);
+      pos += entry->d_reclen;
+    }
+  }
+  if (err == 0 && got < 0) {
+    err = c_errno();
+  }
+  free(buf);
+  (void)close(dir_fd);
+  return err;
+#else  /* !__linux__ */
+  struct dirent* entry;
+  int            err = 0;
+  DIR*           dir = fdopendir(dir_fd);
+  if (!dir) {
+    err = c_errno();
+    (void)close(dir_fd);
+    return err;
+  }
+  while (err == 0 && (entry = readdir(dir)) != NULL) {
+    err = c_dirpack_add(pack, dir_fd, entry->d_name, strlen(entry->d_name), entry->d_type, opts);
+  }
+  (void)closedir(dir); /* also closes dir_fd */
+  return err;
+#endif /* __linux__ */
+}
+
+/**
+ * Scan directory bytevector0_dirpath and return its contents packed into a Scheme vector
+ * #(names offsets types) that needs only four allocations, where:
+ *
+ *   names is a bytevector containing all filenames, concatenated without separators.
+ *
+ *   offsets is a bytevector containing count+1 native-endian uint32 values:
+ *     filename at position i is the range [offsets[i], offsets[i+1]) of names.
+ *
+ *   types is a bytevector containing count octets:
+ *     the type of each filename, i.e. an integer corresponding to enum e_type.
+ *
+ * Options and filters are the same as c_directory_list(), except that o_bytes and o_types
+ * are ignored.
+ *
+ * On Linux, the directory is read with getdents64() and a large buffer, elsewhere with readdir().
+ *
+ * on error, return Scheme integer -errno
+ */
+static ptr c_directory_read(ptr bytevector0_dirpath,
+                            ptr bytevector_filter_prefix,
+                            ptr bytevector_filter_suffix,
+                            ptr vector_filter_pattern,
+                            int options) {
+  s_dirpack             pack = {};
+  s_directory_list_opts opts;
+  const char*           dirpath;
+  iptr                  dirlen;
+  ptr                   names, offsets, types;
+  int                   dir_fd;
+  int                   err;
+
+  if (!Sbytevectorp(bytevector0_dirpath)) {
+    return Sinteger(c_errno_set(EINVAL));
+  }
+  dirpath = (const char*)Sbytevector_data(bytevector0_dirpath);
+  dirlen  = Sbytevector_length(bytevector0_dirpath); /* including final '\0' */
+  if (dirlen <= 0 || dirpath[dirlen - 1] != '\0') {
+    return Sinteger(c_errno_set(EINVAL));
+  }
+  err = c_directory_list_opts_init(
+      &opts, bytevector_filter_prefix, bytevector_filter_suffix, vector_filter_pattern, options);
+  if (err < 0) {
+    return Sinteger(err);
+  } else if (err == 0) {
+    dir_fd = open(dirpath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) {
+      err = c_errno();
+      c_directory_list_opts_free(&opts);
+      return Sinteger(err);
+    }
+    err = c_dirpack_fill(&pack, dir_fd, &opts);
+    c_directory_list_opts_free(&opts);
+    if (err < 0) {
+      c_dirpack_free(&pack);
+      return Sinteger(err);
+    }
+  }
+  names = Smake_bytevector((iptr)pack.names_len, 0);
+  if (pack.names_len) {
+    memcpy(Sbytevector_data(names), pack.names, pack.names_len);
+  }
+  offsets = Smake_bytevector((iptr)((pack.count + 1) * sizeof(uint32_t)), 0);
+  if (pack.count) {
+    memcpy(Sbytevector_data(offsets), pack.offsets, pack.count * sizeof(uint32_t));
+  }
+  {
+    uint32_t end = (uint32_t)pack.names_len;
+    memcpy(Sbytevector_data(offsets) + pack.count * sizeof(uint32_t), &end, sizeof(uint32_t));
+  }
+  types = Smake_bytevector((iptr)pack.count, 0);
+  if (pack.count) {
+    memcpy(Sbytevector_data(types), pack.types, pack.count);
+  }
+  c_dirpack_free(&pack);
+  {
+    ptr ret = Smake_vector(3, names);
+    Svector_set(ret, 1, offsets);
+    Svector_set(ret, 2, types);
+    return ret;
   }
-  return ret;
 }
 
 /** return effective user id of current process, or c_errno() < 0 on error */
@@ -1525,7 +1994,9 @@ static int c_fork_pid(ptr vector_fds_redirect, int existing_pgid) {
    */
   (void)fflush(NULL); /* flushes ALL open output streams */
 
+  c_shm_ring_fork_prepare();
   const int pid = fork();
+  c_shm_ring_fork_done(pid);
   switch (pid) {
     case -1: /* fork() failed */
       return c_errno();
@@ -1563,23 +2034,207 @@ static int c_fork_pid(ptr vector_fds_redirect, int existing_pgid) {
  */
 static char** vector_to_c_argz(ptr vector_of_bytevector0);
 
+#ifdef SCHEMESH_USE_POSIX_SPAWN
+
+/** if zero, c_cmd_spawn() always uses fork() + exec() */
+static int c_posix_spawn_enabled = 1;
+
+/**
+ * enable (if enable > 0) or disable (if enable == 0) spawning external programs
+ * with posix_spawn(). If enable < 0, do not change the current setting.
+ * return previous setting.
+ */
+static int c_cmd_posix_spawn_enable(int enable) {
+  const int ret = c_posix_spawn_enabled;
+  if (enable >= 0) {
+    c_posix_spawn_enabled = enable != 0;
+  }
+  return ret;
+}
+
+/**
+ * convert the redirections in vector_fds_redirect to posix_spawn() file actions.
+ * return 0 on success,
+ * or < 0 if some redirection is invalid or cannot be expressed as a file action.
+ */
+static int c_posix_spawn_file_actions_fill(posix_spawn_file_actions_t* actions,
+                                           ptr                         vector_fds_redirect) {
+  iptr i, n;
+  if (!Svectorp(vector_fds_redirect) || ((n = Svector_length(vector_fds_redirect)) & 3)) {
+    return -EINVAL;
+  }
+  for (i = 0; i + 4 <= n; i += 4) {
+    ptr  from_fd      = Svector_ref(vector_fds_redirect, i + 0);
+    ptr  direction_ch = Svector_ref(vector_fds_redirect, i + 1);
+    ptr  to           = Svector_ref(vector_fds_redirect, i + 3);
+    iptr ifd, to_fd, path_len;
+    int  open_flags, err;
+
+    if (to == Sfalse) {
+      to = Svector_ref(vector_fds_redirect, i + 2);
+    }
+    if (!Sfixnump(from_fd) || (ifd = Sfixnum_value(from_fd)) < 0 || ifd != (iptr)(int)ifd ||
+        !Scharp(direction_ch) ||
+        (open_flags = c_direction_to_open_flags(Schar_value(direction_ch))) < 0) {
+      return -EINVAL;
+    } else if (Sfixnump(to)) {
+      to_fd = Sfixnum_value(to);
+      if (to_fd < -1 || to_fd != (iptr)(int)to_fd || to_fd == ifd) {
+        /*
+         * invalid to_fd, or redirecting an fd to itself:
+         * posix_spawn_file_actions_adddup2(fd, fd) also clears FD_CLOEXEC
+         * on some systems and not on others, while dup2(fd, fd) never does.
+         */
+        return -EINVAL;
+      } else if (to_fd == -1) {
+        err = posix_spawn_file_actions_addclose(actions, (int)ifd);
+      } else {
+        err = posix_spawn_file_actions_adddup2(actions, (int)to_fd, (int)ifd);
+      }
+    } else if (Sbytevectorp(to) && (path_len = Sbytevector_length(to)) > 0 &&
+               Sbytevector_u8_ref(to, path_len - 1) == 0) {
+      err = posix_spawn_file_actions_addopen(
+          actions, (int)ifd, (const char*)Sbytevector_data(to), open_flags, 0666);
+    } else {
+      return -EINVAL;
+    }
+    if (err != 0) {
+      return -err;
+    }
+  }
+  return 0;
+}
+
+/**
+ * return 1 if the PATH contained in envp is the same as getenv("PATH")
+ * or if envp is NULL, otherwise return 0.
+ *
+ * needed because posix_spawnp() searches the PATH of the current process,
+ * while execvp() called after setting environ = envp searches the PATH in envp.
+ */
+static int c_envp_path_is_current(char* const envp[]) {
+  const char* path = getenv("PATH");
+  if (envp) {
+    for (; *envp; ++envp) {
+      if (!strncmp(*envp, "PATH=", 5)) {
+        return path != NULL && !strcmp(*envp + 5, path);
+      }
+    }
+    return path == NULL;
+  }
+  return 1;
+}
+
+/**
+ * try to spawn an external program with posix_spawn() or posix_spawnp(),
+ * which do not copy the page tables of the - possibly large - Chez Scheme heap.
+ *
+ * if program is not NULL, it must be the absolute path of the program to execute,
+ * as resolved by the caller from argv[0] and the PATH in envp.
+ *
+ * return pid > 0 on success.
+ * return <= 0 if the requested chdir, redirections or environment cannot be expressed
+ * with posix_spawn() file actions and attributes, or if posix_spawn() itself failed:
+ * in all such cases, caller should fall back to fork() + exec(), that also reports errors
+ * as usual - for example "command not found".
+ */
+static int c_cmd_posix_spawn(const char* program,
+                             char* const argv[],
+                             char* const envp[],
+                             ptr         bytevector0_chdir_or_false,
+                             ptr         vector_fds_redirect,
+                             int         existing_pgid) {
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t          attr;
+  sigset_t                   sigset;
+  const int                  use_path = program == NULL && strchr(argv[0], '/') == NULL;
+  short                      flags    = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+  pid_t                      pid      = 0;
+  int                        err;
+
+  if (!c_posix_spawn_enabled || (use_path && !c_envp_path_is_current(envp))) {
+    return 0;
+  }
+#ifndef SCHEMESH_HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR_NP
+  if (bytevector0_chdir_or_false != Sfalse) {
+    return 0;
+  }
+#endif
+  if (posix_spawn_file_actions_init(&actions) != 0) {
+    return 0;
+  }
+  if ((err = posix_spawnattr_init(&attr)) != 0) {
+    (void)posix_spawn_file_actions_destroy(&actions);
+    return 0;
+  }
+#ifdef SCHEMESH_HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCHDIR_NP
+  /* c_cmd_spawn_or_exec() changes directory before redirecting fds: do the same */
+  if (bytevector0_chdir_or_false != Sfalse) {
+    err = posix_spawn_file_actions_addchdir_np(
+        &actions, (const char*)Sbytevector_data(bytevector0_chdir_or_false));
+  }
+#endif
+  if (err == 0) {
+    err = c_posix_spawn_file_actions_fill(&actions, vector_fds_redirect);
+  }
+  if (err == 0 && existing_pgid >= 0) {
+    flags |= POSIX_SPAWN_SETPGROUP;
+    err = posix_spawnattr_setpgroup(&attr, (pid_t)existing_pgid);
+  }
+  if (err == 0) {
+    /* same as c_signals_setdefault() called by fork()ed child */
+    c_signals_fill_setdefault(&sigset);
+    err = posix_spawnattr_setsigdefault(&attr, &sigset);
+  }
+  if (err == 0 && (err = pthread_sigmask(SIG_SETMASK, NULL, &sigset)) == 0) {
+    /* same as fork()ed child: inherit signal mask of calling thread */
+    err = posix_spawnattr_setsigmask(&attr, &sigset);
+  }
+  if (err == 0) {
+    err = posix_spawnattr_setflags(&attr, flags);
+  }
+  if (err == 0) {
+    char* const* env = envp ? envp : environ;
+    if (use_path) {
+      err = posix_spawnp(&pid, argv[0], &actions, &attr, argv, env);
+    } else {
+      err = posix_spawn(&pid, program ? program : argv[0], &actions, &attr, argv, env);
+    }
+  }
+  (void)posix_spawnattr_destroy(&attr);
+  (void)posix_spawn_file_actions_destroy(&actions);
+
+#ifdef SCHEMESH_DEBUG_POSIX
+  fprintf(stdout, "c_cmd_posix_spawn %s -> pid %d, err %d\n", argv[0], (int)pid, err);
+  fflush(stdout);
+#endif
+  return err == 0 ? (int)pid : 0;
+}
+
+#endif /* SCHEMESH_USE_POSIX_SPAWN */
+
 /**
  * optionally fork(), then exec() an external program.
+ * if bytevector0_program_or_false is a bytevector0, it must contain the absolute path
+ * of the program to execute, already resolved from argv[0] by searching the PATH:
+ * if executing it fails, fall back on searching the PATH for argv[0] as usual.
  * if forked, return pid in parent process.
  * if existing_pgid > 0, add process to given pgid i.e. process group
  * if existing_pgid == 0 create a new process id (numerically equal to the process id)
  *                       and move process into it
  */
 static int c_cmd_spawn_or_exec(ptr vector_of_bytevector0_cmdline,
+                               ptr bytevector0_program_or_false,
                                ptr bytevector0_chdir_or_false,
                                ptr vector_fds_redirect,
                                ptr vector_of_bytevector0_environ,
                                int existing_pgid,
                                int is_spawn) {
 
-  char** argv = vector_to_c_argz(vector_of_bytevector0_cmdline);
-  char** envp = vector_to_c_argz(vector_of_bytevector0_environ);
-  int    err  = 0;
+  char**      argv    = vector_to_c_argz(vector_of_bytevector0_cmdline);
+  char**      envp    = vector_to_c_argz(vector_of_bytevector0_environ);
+  const char* program = NULL;
+  int         err     = 0;
   if (!argv || (!envp && Svectorp(vector_of_bytevector0_environ))) {
     err = -ENOMEM;
     goto out;
@@ -1588,6 +2243,19 @@ static int c_cmd_spawn_or_exec(ptr vector_of_bytevector0_cmdline,
     err = -EINVAL;
     goto out;
   }
+  if (bytevector0_program_or_false != Sfalse) {
+    iptr program_len;
+    if (!Sbytevectorp(bytevector0_program_or_false)) {
+      err = -EINVAL;
+      goto out;
+    }
+    program     = (const char*)Sbytevector_data(bytevector0_program_or_false);
+    program_len = Sbytevector_length(bytevector0_program_or_false);
+    if (program_len <= 1 || program[0] != '/' || program[program_len - 1] != 0) {
+      err = -EINVAL;
+      goto out;
+    }
+  }
   if (bytevector0_chdir_or_false != Sfalse) {
     const octet* dir;
     iptr         dir_len;
@@ -1608,6 +2276,17 @@ static int c_cmd_spawn_or_exec(ptr vector_of_bytevector0_cmdline,
   fflush(stdout);
 #endif
 
+#ifdef SCHEMESH_USE_POSIX_SPAWN
+  if (is_spawn &&
+      (err = c_cmd_posix_spawn(
+           program, argv, envp, bytevector0_chdir_or_false, vector_fds_redirect, existing_pgid)) >
+          0) {
+    /* same as parent after fork() below */
+    (void)c_pgid_set(err, existing_pgid);
+    goto out;
+  }
+#endif
+
   if (is_spawn) {
     /**
      * issue #26: no need to call fflush(NULL) here,
@@ -1655,6 +2334,10 @@ static int c_cmd_spawn_or_exec(ptr vector_of_bytevector0_cmdline,
       if (envp) {
         environ = envp;
       }
+      if (program) {
+        /* if it fails, for example with ENOEXEC, execvp() below retries as usual */
+        (void)execv(program, argv);
+      }
       if (strchr(argv[0], '/')) {
         (void)execv(argv[0], argv);
       } else {
@@ -1696,6 +2379,7 @@ static int c_cmd_exec(ptr vector_of_bytevector0_cmdline,
                       ptr vector_of_bytevector0_environ) {
 
   return c_cmd_spawn_or_exec(vector_of_bytevector0_cmdline,
+                             Sfalse, /* search PATH for program */
                              bytevector0_chdir_or_false,
                              vector_fds_redirect,
                              vector_of_bytevector0_environ,
@@ -1705,17 +2389,21 @@ static int c_cmd_exec(ptr vector_of_bytevector0_cmdline,
 
 /**
  * fork() and exec() an external program, return pid.
+ * if bytevector0_program_or_false is a bytevector0, it must contain the absolute path
+ * of the program to execute, already resolved from argv[0]. Otherwise search PATH for argv[0].
  * if existing_pgid > 0, add process to given pgid i.e. process group
  * if existing_pgid == 0, create a new process group id == process id, and move process into it.
  * if existing_pgid < 0, process inherits the process group id from current process
  */
 static int c_cmd_spawn(ptr vector_of_bytevector0_cmdline,
+                       ptr bytevector0_program_or_false,
                        ptr bytevector0_chdir_or_false,
                        ptr vector_fds_redirect,
                        ptr vector_of_bytevector0_environ,
                        int existing_pgid) {
 
   return c_cmd_spawn_or_exec(vector_of_bytevector0_cmdline,
+                             bytevector0_program_or_false,
                              bytevector0_chdir_or_false,
                              vector_fds_redirect,
                              vector_of_bytevector0_environ,
@@ -1766,6 +2454,115 @@ static int c_pgid_foreground_cas(int old_pgid, int new_pgid) {
   return tcsetpgrp(tty_fd, new_pgid) >= 0 ? 0 : c_errno();
 }
 
+/**
+ * avoid WCONTINUED on macOS:
+ * it repeatedly reports the same pid as "continued", causing a busy loop
+ */
+#if defined(WCONTINUED) && !defined(__APPLE__)
+#define SCHEMESH_WAITPID_OPTIONS (WUNTRACED | WCONTINUED)
+#else
+#define SCHEMESH_WAITPID_OPTIONS WUNTRACED
+#endif
+
+/**
+ * convert wstatus set by waitpid() to status_flag, see c_pid_wait() below.
+ * return -1 if wstatus is not recognized.
+ */
+static int c_pid_wait_status(int wstatus) {
+  if (WIFEXITED(wstatus)) {
+    return (int)(unsigned char)WEXITSTATUS(wstatus);
+  } else if (WIFSIGNALED(wstatus)) {
+    return 256 + WTERMSIG(wstatus);
+  } else if (WIFSTOPPED(wstatus)) {
+    return 512 + WSTOPSIG(wstatus);
+#ifdef WIFCONTINUED
+  } else if (WIFCONTINUED(wstatus)) {
+    return 768;
+#endif
+  }
+  return -1;
+}
+
+/* ------------------------------------ rusage of exited children ------------------------------ */
+
+/*
+ * when c_pid_rusage_enabled != 0, c_pid_wait() and c_pid_wait_batch() call wait4() instead of waitpid()
+ * and remember the resource usage of the last SCHEMESH_RUSAGE_N exited children,
+ * which can be retrieved with c_pid_rusage_take().
+ *
+ * Accessed only by the thread that waits for child processes, i.e. the one running the job scheduler.
+ */
+#define SCHEMESH_RUSAGE_N 256
+
+typedef struct s_pid_rusage {
+  pid_t   pid; /* 0 if slot is empty */
+  int64_t user_usec;
+  int64_t sys_usec;
+  int64_t maxrss_kib;
+} s_pid_rusage;
+
+static int          c_pid_rusage_enabled = 0;
+static unsigned     c_pid_rusage_next    = 0;
+static s_pid_rusage c_pid_rusage_ring[SCHEMESH_RUSAGE_N];
+
+/** enable or disable collecting resource usage of exited children */
+static void c_pid_rusage_enable(int enable) {
+  c_pid_rusage_enabled = enable != 0;
+  if (!c_pid_rusage_enabled) {
+    memset(c_pid_rusage_ring, '\0', sizeof(c_pid_rusage_ring));
+  }
+}
+
+/**
+ * remove resource usage of exited child process pid from the ring and return it
+ * as a Scheme vector #(user-microseconds sys-microseconds maxrss-KiB),
+ * or return #f if not available.
+ */
+static ptr c_pid_rusage_take(int pid) {
+  unsigned i;
+  for (i = 0; pid > 0 && i < SCHEMESH_RUSAGE_N; i++) {
+    s_pid_rusage* e = &c_pid_rusage_ring[i];
+    if (e->pid == (pid_t)pid) {
+      ptr vec = Smake_vector(3, Sfalse);
+      Svector_set(vec, 0, Sinteger64(e->user_usec));
+      Svector_set(vec, 1, Sinteger64(e->sys_usec));
+      Svector_set(vec, 2, Sinteger64(e->maxrss_kib));
+      e->pid = 0;
+      return vec;
+    }
+  }
+  return Sfalse;
+}
+
+static int64_t c_timeval_to_usec(const struct timeval* tv) {
+  return (int64_t)tv->tv_sec * 1000000 + (int64_t)tv->tv_usec;
+}
+
+/**
+ * call waitpid(), or wait4() if c_pid_rusage_enabled != 0
+ * and in such case remember the resource usage of children that exited or were killed.
+ */
+static pid_t c_pid_waitpid(pid_t pid, int* wstatus, int options) {
+  struct rusage ru;
+  pid_t         ret_pid;
+  if (!c_pid_rusage_enabled) {
+    return waitpid(pid, wstatus, options);
+  }
+  ret_pid = wait4(pid, wstatus, options, &ru);
+  if (ret_pid > 0 && (WIFEXITED(*wstatus) || WIFSIGNALED(*wstatus))) {
+    s_pid_rusage* e = &c_pid_rusage_ring[c_pid_rusage_next++ % SCHEMESH_RUSAGE_N];
+    e->pid          = ret_pid;
+    e->user_usec    = c_timeval_to_usec(&ru.ru_utime);
+    e->sys_usec     = c_timeval_to_usec(&ru.ru_stime);
+#ifdef __APPLE__
+    e->maxrss_kib = (int64_t)ru.ru_maxrss / 1024; /* bytes on macOS */
+#else
+    e->maxrss_kib = (int64_t)ru.ru_maxrss; /* KiB on Linux and BSD */
+#endif
+  }
+  return ret_pid;
+}
+
 /**
  * call waitpid(pid, WUNTRACED|WCONTINUED) i.e. check if process specified by pid
  * finished, stopped or resumed.
@@ -1791,19 +2588,11 @@ static ptr c_pid_wait(int pid, int may_block) {
   int   wstatus = 0;
   int   result  = 0;
   int   retry_n = 1;
-  pid_t ret_pid;
-  /*
-   * avoid WCONTINUED on macOS:
-   * it repeatedly reports the same pid as "continued", causing a busy loop
-   */
-#if defined(WCONTINUED) && !defined(__APPLE__)
-  const int options = WUNTRACED | WCONTINUED;
-#else
-  const int options = WUNTRACED;
-#endif
+  pid_t     ret_pid;
+  const int options = SCHEMESH_WAITPID_OPTIONS;
 
 again:
-  ret_pid = waitpid((pid_t)pid, &wstatus, options | (may_block ? 0 : WNOHANG));
+  ret_pid = c_pid_waitpid((pid_t)pid, &wstatus, options | (may_block ? 0 : WNOHANG));
 
   if (ret_pid <= 0) { /* 0 if children exist but did not change status */
     int err = 0;
@@ -1835,17 +2624,7 @@ again:
     fflush(stderr);
 #endif /* DEBUG_WAIT_PID */
     return err == 0 ? Snil : Sinteger(err);
-  } else if (WIFEXITED(wstatus)) {
-    result = (int)(unsigned char)WEXITSTATUS(wstatus);
-  } else if (WIFSIGNALED(wstatus)) {
-    result = 256 + WTERMSIG(wstatus);
-  } else if (WIFSTOPPED(wstatus)) {
-    result = 512 + WSTOPSIG(wstatus);
-#ifdef WIFCONTINUED
-  } else if (WIFCONTINUED(wstatus)) {
-    result = 768;
-#endif
-  } else {
+  } else if ((result = c_pid_wait_status(wstatus)) < 0) {
     return Sinteger(c_errno_set(EINVAL));
   }
 #ifdef SCHEMESH_DEBUG_WAIT_PID
@@ -1861,6 +2640,92 @@ again:
   return Scons(Sinteger(ret_pid), Sinteger(result));
 }
 
+/**
+ * call waitpid(pid, WUNTRACED|WCONTINUED|WNOHANG) repeatedly, until no more child processes
+ * matching pid changed status, i.e. reap all pending status changes with a single call from Scheme.
+ *
+ * Argument first must be either Scheme empty list '() or a Scheme cons (pid . status_flag)
+ * previously returned by c_pid_wait(): if it's a cons, it is stored as first vector element.
+ *
+ * Return a Scheme vector of conses (pid . status_flag), in the order reported by waitpid(),
+ * which is empty if no child process changed status, or c_errno() on error.
+ * For the meaning of status_flag, see c_pid_wait() above.
+ */
+static ptr c_pid_wait_batch(int pid, ptr first) {
+  ptr    ret = Snil;
+  ptr    vec;
+  iptr   n = 0;
+  int    wstatus;
+  int    result;
+  pid_t  ret_pid;
+  if (Spairp(first)) {
+    ret = Scons(first, ret);
+    n++;
+  }
+  for (;;) {
+    wstatus = 0;
+    ret_pid = c_pid_waitpid((pid_t)pid, &wstatus, SCHEMESH_WAITPID_OPTIONS | WNOHANG);
+    if (ret_pid < 0) {
+      int err = c_errno();
+      if (err == -EINTR) {
+        continue;
+      }
+      if (err != -EAGAIN && err != -ECHILD && n == 0) {
+        return Sinteger(err);
+      }
+      break; /* no more children, or error after reaping some: report what we have */
+    } else if (ret_pid == 0) {
+      break; /* children exist but did not change status */
+    } else if ((result = c_pid_wait_status(wstatus)) >= 0) {
+      ret = Scons(Scons(Sinteger(ret_pid), Sinteger(result)), ret);
+      n++;
+    }
+  }
+  vec = Smake_vector(n, Snil);
+  while (n > 0) { /* ret is in reverse order */
+    Svector_set(vec, --n, Scar(ret));
+    ret = Scdr(ret);
+  }
+  return vec;
+}
+
+/**
+ * return a file descriptor that becomes readable when child process pid exits,
+ * so that the caller can wait for multiple child processes together with other file descriptors
+ * using poll() or similar functions.
+ * The child must still be reaped with waitpid(), for example by calling c_pid_wait_batch().
+ *
+ * Uses pidfd_open() on Linux, and a kqueue with EVFILT_PROC filter on BSD and macOS.
+ * Return file descriptor, or c_errno() on error: -ENOSYS if not supported by the OS.
+ */
+static int c_pid_fd_open(int pid) {
+#if defined(__linux__) && defined(SYS_pidfd_open)
+  int fd = (int)syscall(SYS_pidfd_open, (pid_t)pid, 0);
+  if (fd < 0) {
+    return c_errno();
+  }
+  (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+  return fd;
+#elif defined(SCHEMESH_HAVE_KQUEUE)
+  struct kevent change;
+  int           fd = kqueue();
+  if (fd < 0) {
+    return c_errno();
+  }
+  EV_SET(&change, (uintptr_t)pid, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, NULL);
+  if (kevent(fd, &change, 1, NULL, 0, NULL) < 0) {
+    int err = c_errno();
+    (void)close(fd);
+    return err;
+  }
+  (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+  return fd;
+#else
+  (void)pid;
+  return c_errno_set(ENOSYS);
+#endif
+}
+
 static char** vector_to_c_argz(ptr vector_of_bytevector0) {
   ptr    vec    = vector_of_bytevector0;
   char** c_argz = NULL;
@@ -1913,6 +2778,16 @@ static uptr c_thread_count(void) {
 #endif
 }
 
+/** return the number of online CPUs, or 1 if unknown */
+static int c_cpu_count(void) {
+#ifdef _SC_NPROCESSORS_ONLN
+  const long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 1 ? (n < 0x7FFFFFFF ? (int)n : 0x7FFFFFFF) : 1;
+#else
+  return 1;
+#endif
+}
+
 /** must be called with locked $tc-mutex */
 static ptr c_threads(void) {
   extern volatile ptr S_threads;
@@ -1935,6 +2810,7 @@ int schemesh_register_c_functions_posix(void) {
   Sregister_symbol("c_errno_einval", &c_errno_einval);
   Sregister_symbol("c_errno_enoent", &c_errno_enoent);
   Sregister_symbol("c_errno_enotdir", &c_errno_enotdir);
+  Sregister_symbol("c_errno_epipe", &c_errno_epipe);
   Sregister_symbol("c_errno_esrch", &c_errno_esrch);
 
   Sregister_symbol("c_strerror_string", &c_strerror_string);
@@ -1954,10 +2830,36 @@ int schemesh_register_c_functions_posix(void) {
   Sregister_symbol("c_fd_write", &c_fd_write);
   Sregister_symbol("c_fd_write_u8", &c_fd_write_u8);
   Sregister_symbol("c_fd_select", &c_fd_select);
+  Sregister_symbol("c_poller_open", &c_poller_open);
+  Sregister_symbol("c_poller_close", &c_poller_close);
+  Sregister_symbol("c_poller_set", &c_poller_set);
+  Sregister_symbol("c_poller_wait", &c_poller_wait);
+  Sregister_symbol("c_poller_ready", &c_poller_ready);
+  Sregister_symbol("c_shm_ring_create", &c_shm_ring_create);
+  Sregister_symbol("c_shm_ring_map", &c_shm_ring_map);
+  Sregister_symbol("c_shm_ring_close", &c_shm_ring_close);
+  Sregister_symbol("c_shm_ring_write", &c_shm_ring_write);
+  Sregister_symbol("c_shm_ring_read", &c_shm_ring_read);
+  Sregister_symbol("c_shm_ring_wait", &c_shm_ring_wait);
+  Sregister_symbol("c_linemap_open", &c_linemap_open);
+  Sregister_symbol("c_linemap_close", &c_linemap_close);
+  Sregister_symbol("c_linemap_changed", &c_linemap_changed);
+  Sregister_symbol("c_linemap_lock", &c_linemap_lock);
+  Sregister_symbol("c_linemap_same_file", &c_linemap_same_file);
+  Sregister_symbol("c_linemap_count", &c_linemap_count);
+  Sregister_symbol("c_linemap_ref", &c_linemap_ref);
+  Sregister_symbol("c_linemap_duplicates", &c_linemap_duplicates);
+  Sregister_symbol("c_linemap_compact", &c_linemap_compact);
+  Sregister_symbol("c_mapfile_open", &c_mapfile_open);
+  Sregister_symbol("c_mapfile_close", &c_mapfile_close);
+  Sregister_symbol("c_mapfile_size", &c_mapfile_size);
+  Sregister_symbol("c_mapfile_read", &c_mapfile_read);
+  Sregister_symbol("c_fd_pipe_capacity", &c_fd_pipe_capacity);
   Sregister_symbol("c_fd_setnonblock", &c_fd_setnonblock);
   Sregister_symbol("c_fd_redirect", &c_fd_redirect);
   Sregister_symbol("c_open_file_fd", &c_open_file_fd);
   Sregister_symbol("c_open_pipe_fds", &c_open_pipe_fds);
+  Sregister_symbol("c_open_memory_fd", &c_open_memory_fd);
   Sregister_symbol("c_open_socketpair_fds", &c_open_socketpair_fds);
 
   Sregister_symbol("c_tty_restore", &c_tty_restore);
@@ -1968,11 +2870,18 @@ int schemesh_register_c_functions_posix(void) {
 
   Sregister_symbol("c_cmd_exec", &c_cmd_exec);
   Sregister_symbol("c_cmd_spawn", &c_cmd_spawn);
+#ifdef SCHEMESH_USE_POSIX_SPAWN
+  Sregister_symbol("c_cmd_posix_spawn_enable", &c_cmd_posix_spawn_enable);
+#endif
   Sregister_symbol("c_euid_get", &c_euid_get);
   Sregister_symbol("c_pid_get", &c_pid_get);
   Sregister_symbol("c_pgid_get", &c_pgid_get);
   Sregister_symbol("c_fork_pid", &c_fork_pid);
   Sregister_symbol("c_pid_wait", &c_pid_wait);
+  Sregister_symbol("c_pid_wait_batch", &c_pid_wait_batch);
+  Sregister_symbol("c_pid_rusage_enable", &c_pid_rusage_enable);
+  Sregister_symbol("c_pid_rusage_take", &c_pid_rusage_take);
+  Sregister_symbol("c_pid_fd_open", &c_pid_fd_open);
   Sregister_symbol("c_pgid_foreground_get", &c_pgid_foreground_get);
   Sregister_symbol("c_pgid_foreground_set", &c_pgid_foreground_set);
   Sregister_symbol("c_pgid_foreground_cas", &c_pgid_foreground_cas);
@@ -1983,13 +2892,20 @@ int schemesh_register_c_functions_posix(void) {
   Sregister_symbol("c_get_userhome", &c_get_userhome);
   Sregister_symbol("c_exit", &c_exit);
   Sregister_symbol("c_directory_list", &c_directory_list);
+  Sregister_symbol("c_directory_read", &c_directory_read);
   Sregister_symbol("c_file_delete", &c_file_delete);
+  Sregister_symbol("c_file_mtime", &c_file_mtime);
   Sregister_symbol("c_file_rename", &c_file_rename);
   Sregister_symbol("c_file_type", &c_file_type);
+  Sregister_symbol("c_glob_start", &c_glob_start);
+  Sregister_symbol("c_glob_wait", &c_glob_wait);
+  Sregister_symbol("c_glob_next", &c_glob_next);
+  Sregister_symbol("c_glob_end", &c_glob_end);
 
   Sregister_symbol("c_pthread_kill", &c_pthread_kill);
   Sregister_symbol("c_pthread_self", &c_pthread_self);
   Sregister_symbol("c_thread_count", &c_thread_count);
+  Sregister_symbol("c_cpu_count", &c_cpu_count);
   Sregister_symbol("c_threads", &c_threads);
   Sregister_symbol("c_sched_yield", &c_sched_yield);
 
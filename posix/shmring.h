@@ -0,0 +1,572 @@
+/**
+ * Copyright (C) 2023-2025 by Massimiliano Ghilardi
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/** this file should be included only by posix/posix.c */
+#ifndef SCHEMESH_POSIX_POSIX_C
+#error "posix/shmring.h should only be #included by posix/posix.c"
+#endif
+
+/* ------------------------------------ shared-memory ring -------------------------------------- */
+
+/*
+ * Single-producer, single-consumer byte ring in shared memory,
+ * used by (channel-shm-pair) in ipc/channel.ss to exchange serialized data between processes
+ * with one memcpy() in each direction and no system calls, except for wakeups.
+ *
+ * The ring is backed by a memfd on Linux and by an unlinked shm_open() object elsewhere:
+ * its file descriptor can be mapped again by other processes.
+ *
+ * head and tail are 32-bit counters of bytes written and read, that wrap around:
+ * their difference is the number of buffered bytes, because capacity is a power of two <= 2^30.
+ *
+ * Wakeups use a futex on Linux, which costs a system call only if the other side is actually waiting,
+ * and a short sleep elsewhere.
+ *
+ * Like a pipe, each side of the ring is closed only when no process holds it open anymore.
+ * Each process that maps the ring claims one of the header slots: it stores there
+ * the sides it holds open, and takes a POSIX advisory lock on the byte of the ring file
+ * at the same offset as the slot index.
+ * Such locks belong to a process: they are released when it exits or it is killed,
+ * even before it is reaped, and they are not inherited by fork() - thus PID reuse cannot fool them.
+ * c_shm_ring_close() and c_shm_ring_wait() with a timeout check the locks
+ * of the slots holding the other side, and mark it as closed if none of them is alive.
+ *
+ * Mappings are tracked per process: closing a side clears it only from the slot of current process,
+ * and the ring is unmapped when current process closes both sides.
+ * Since closing ANY file descriptor of a file releases all the POSIX locks that a process holds on it,
+ * c_shm_ring_map() takes ownership of the ring file descriptor, and each process should map a ring
+ * only once and should not keep other file descriptors referring to it.
+ * c_fork_pid() calls c_shm_ring_fork_prepare() and c_shm_ring_fork_done()
+ * to reserve for the child a slot with the same sides as its parent, before the parent can close them.
+ * Processes created by other means do not claim any slot and should not use the ring.
+ */
+
+#include <sys/mman.h> /* mmap(), munmap(), shm_open(), shm_unlink() */
+#ifdef __linux__
+#include <linux/futex.h> /* FUTEX_WAIT, FUTEX_WAKE */
+#endif
+
+enum {
+  shm_ring_header_size  = 4096, /* data starts at this offset */
+  shm_ring_min_capacity = 4096,
+  shm_ring_max_capacity = 1 << 30,
+  shm_ring_slot_n       = 64, /* max number of processes that can map the same ring */
+};
+
+enum {
+  shm_ring_slot_free    = 0,
+  shm_ring_slot_claimed = 1, /* alive while the owner process holds the lock on byte slot index */
+  shm_ring_slot_handoff = 2, /* reserved for a child being forked, alive while its parent is */
+};
+
+typedef struct s_shm_ring_slot {
+  ATOMIC uint32_t state;  /* one of shm_ring_slot_... */
+  ATOMIC uint32_t rw_mask; /* sides held open by slot owner: bitwise-or of mask_READ, mask_WRITE */
+  ATOMIC uint32_t parent;  /* if state is shm_ring_slot_handoff, slot index of forking parent */
+  uint32_t        pad;
+} s_shm_ring_slot;
+
+typedef struct s_shm_ring {
+  uint32_t        capacity; /* power of two */
+  ATOMIC uint32_t closed;   /* bitwise-or of mask_READ if consumer closed, mask_WRITE if producer closed */
+  char            pad0[56];
+  ATOMIC uint32_t head;            /* bytes written by producer, modulo 2^32 */
+  ATOMIC uint32_t readers_waiting; /* > 0 if consumer is waiting for data */
+  ATOMIC uint32_t read_seq;        /* futex word: changed to wake up the consumer */
+  char            pad1[52];
+  ATOMIC uint32_t tail;            /* bytes read by consumer, modulo 2^32 */
+  ATOMIC uint32_t writers_waiting; /* > 0 if producer is waiting for free space */
+  ATOMIC uint32_t write_seq;       /* futex word: changed to wake up the producer */
+  char            pad2[52];
+  s_shm_ring_slot slots[shm_ring_slot_n];
+} s_shm_ring;
+
+/** per-process state of a mapped shared-memory ring. Its address is the handle passed to Scheme */
+typedef struct s_shm_ring_local {
+  s_shm_ring*              ring;
+  struct s_shm_ring_local* next;
+  int                      fd;      /* ring file descriptor, holds the lock of slot */
+  int                      slot;    /* index of slot claimed by current process, or -1 */
+  int                      handoff; /* index of slot reserved by c_shm_ring_fork_prepare(), or -1 */
+  unsigned                 n_read;  /* number of channels of current process reading from the ring */
+  unsigned                 n_write; /* number of channels of current process writing into the ring */
+} s_shm_ring_local;
+
+/* all shared-memory rings mapped by current process, protected by c_shm_ring_mutex */
+static s_shm_ring_local* c_shm_ring_list  = NULL;
+static pthread_mutex_t   c_shm_ring_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static octet* c_shm_ring_data(s_shm_ring* ring) {
+  return (octet*)ring + shm_ring_header_size;
+}
+
+static uint32_t c_shm_ring_local_mask(const s_shm_ring_local* local) {
+  return (local->n_read ? mask_READ : 0) | (local->n_write ? mask_WRITE : 0);
+}
+
+/** wait until *addr != val, or timeout. spurious wakeups are allowed. return 0 or c_errno() */
+static int c_shm_ring_futex_wait(ATOMIC uint32_t* addr, uint32_t val, int timeout_milliseconds) {
+#if defined(__linux__) && defined(SYS_futex)
+  struct timespec  ts;
+  struct timespec* pts = NULL;
+  if (timeout_milliseconds >= 0) {
+    ts.tv_sec  = timeout_milliseconds / 1000;
+    ts.tv_nsec = (long)(timeout_milliseconds % 1000) * 1000000;
+    pts        = &ts;
+  }
+  /* not FUTEX_WAIT_PRIVATE: the other side may be a different process */
+  if (syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAIT, val, pts, NULL, 0) < 0 && errno != EAGAIN &&
+      errno != ETIMEDOUT) {
+    return c_errno();
+  }
+  return 0;
+#else
+  /* no portable cross-process wakeup: poll with a short sleep */
+  struct timespec ts = {0, 200000}; /* 0.2 milliseconds */
+  (void)timeout_milliseconds;
+  if (atomic_load(addr) == val && nanosleep(&ts, NULL) < 0) {
+    return c_errno();
+  }
+  return 0;
+#endif
+}
+
+/** change *seq and wake up all threads waiting on it */
+static void c_shm_ring_futex_wake(ATOMIC uint32_t* seq) {
+  atomic_fetch_add(seq, 1);
+#if defined(__linux__) && defined(SYS_futex)
+  (void)syscall(SYS_futex, (uint32_t*)seq, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+/**
+ * lock (if lock_type == F_WRLCK) or unlock (if lock_type == F_UNLCK) the byte of ring file
+ * at offset slot. Does not block. return 0 on success, or c_errno() on error
+ */
+static int c_shm_ring_slot_lock(int fd, int slot, short lock_type) {
+  struct flock fl;
+  memset(&fl, '\0', sizeof(fl));
+  fl.l_type   = lock_type;
+  fl.l_whence = SEEK_SET;
+  fl.l_start  = (off_t)slot;
+  fl.l_len    = 1;
+  return fcntl(fd, F_SETLK, &fl) < 0 ? c_errno() : 0;
+}
+
+/** return != 0 if some other process holds the lock on the byte of ring file at offset slot */
+static int c_shm_ring_slot_locked(int fd, int slot) {
+  struct flock fl;
+  memset(&fl, '\0', sizeof(fl));
+  fl.l_type   = F_WRLCK;
+  fl.l_whence = SEEK_SET;
+  fl.l_start  = (off_t)slot;
+  fl.l_len    = 1;
+  /* on error, assume the owner is alive: better a ring that stays open than a spurious end-of-file */
+  return fcntl(fd, F_GETLK, &fl) < 0 || fl.l_type != F_UNLCK;
+}
+
+/** return != 0 if slot is owned by current process or by some other process that is still alive */
+static int c_shm_ring_slot_alive(const s_shm_ring_local* local, uint32_t slot) {
+  const s_shm_ring_slot* s = &local->ring->slots[slot];
+  switch (atomic_load(&s->state)) {
+    case shm_ring_slot_claimed:
+      return (int)slot == local->slot || c_shm_ring_slot_locked(local->fd, (int)slot);
+    case shm_ring_slot_handoff:
+      /* do not follow handoff chains: a parent slot in handoff state counts as dead */
+      slot = atomic_load(&s->parent);
+      return slot < shm_ring_slot_n &&
+             atomic_load(&local->ring->slots[slot].state) == shm_ring_slot_claimed &&
+             ((int)slot == local->slot || c_shm_ring_slot_locked(local->fd, (int)slot));
+    default:
+      return 0;
+  }
+}
+
+/**
+ * find a slot that is free, or whose owner is dead, and mark it with new_state.
+ * if new_state is shm_ring_slot_claimed, also lock it.
+ * return slot index, or -1 if all slots are in use.
+ */
+static int c_shm_ring_slot_claim(s_shm_ring_local* local, uint32_t new_state, uint32_t rw_mask) {
+  s_shm_ring* ring = local->ring;
+  uint32_t    i;
+  int         err;
+  for (i = 0; i < shm_ring_slot_n; i++) {
+    s_shm_ring_slot* s     = &ring->slots[i];
+    uint32_t         state = atomic_load(&s->state);
+    if (state != shm_ring_slot_free && c_shm_ring_slot_alive(local, i)) {
+      continue;
+    }
+    err = c_shm_ring_slot_lock(local->fd, (int)i, F_WRLCK);
+    if (err == -EAGAIN || err == -EACCES) {
+      continue; /* another process just claimed it */
+    }
+    /* other errors mean locks are not supported: claim the slot anyway, losing owner-death detection */
+    /* holding the lock, only processes reserving a handoff slot can race with us */
+    if (atomic_compare_exchange_strong(&s->state, &state, new_state)) {
+      atomic_store(&s->rw_mask, rw_mask);
+      atomic_store(&s->parent, (uint32_t)local->slot);
+      if (new_state != shm_ring_slot_claimed) {
+        (void)c_shm_ring_slot_lock(local->fd, (int)i, F_UNLCK);
+      }
+      return (int)i;
+    }
+    (void)c_shm_ring_slot_lock(local->fd, (int)i, F_UNLCK);
+  }
+  return -1;
+}
+
+/**
+ * if no live process holds open the side rw_mask, i.e. mask_READ or mask_WRITE of the ring,
+ * mark such side as closed and wake up both sides.
+ */
+static void c_shm_ring_check_side(const s_shm_ring_local* local, uint32_t rw_mask) {
+  s_shm_ring* ring = local->ring;
+  uint32_t    i;
+  if (atomic_load(&ring->closed) & rw_mask) {
+    return;
+  }
+  for (i = 0; i < shm_ring_slot_n; i++) {
+    if ((atomic_load(&ring->slots[i].rw_mask) & rw_mask) && c_shm_ring_slot_alive(local, i)) {
+      return;
+    }
+  }
+  atomic_fetch_or(&ring->closed, rw_mask);
+  c_shm_ring_futex_wake(&ring->read_seq);
+  c_shm_ring_futex_wake(&ring->write_seq);
+}
+/**
+ * create a shared-memory ring with specified capacity, rounded up to a power of two.
+ * return its file descriptor, which is close-on-exec, or c_errno() on error.
+ */
+static int c_shm_ring_create(uptr capacity) {
+  s_shm_ring* ring;
+  uptr        cap = shm_ring_min_capacity;
+  int         fd;
+  while (cap < capacity && cap < shm_ring_max_capacity) {
+    cap *= 2;
+  }
+#if defined(__linux__) && defined(SYS_memfd_create)
+  fd = (int)syscall(SYS_memfd_create, "schemesh-channel", 1 /* MFD_CLOEXEC */);
+#else
+  {
+    char name[64];
+    unsigned i = 0;
+    do {
+      snprintf(name, sizeof(name), "/schemesh-channel-%ld-%u", (long)getpid(), i);
+      fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    } while (fd < 0 && errno == EEXIST && ++i < 1000);
+    if (fd >= 0) {
+      (void)shm_unlink(name);
+      (void)fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+  }
+#endif
+  if (fd < 0) {
+    return c_errno();
+  }
+  if (ftruncate(fd, (off_t)(shm_ring_header_size + cap)) < 0) {
+    int err = c_errno();
+    (void)close(fd);
+    return err;
+  }
+  ring = mmap(NULL, shm_ring_header_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (ring == MAP_FAILED) {
+    int err = c_errno();
+    (void)close(fd);
+    return err;
+  }
+  /* ftruncate() zero-filled the whole ring */
+  ring->capacity = (uint32_t)cap;
+  (void)munmap(ring, shm_ring_header_size);
+  return fd;
+}
+
+/**
+ * map in memory the shared-memory ring created with c_shm_ring_create(),
+ * and claim a slot for current process, holding open the side(s) indicated by rw_mask.
+ * On success, take ownership of fd, which must not be closed by the caller:
+ * the c_shm_ring_close() that closes the last side held by current process also closes fd.
+ * return a Scheme integer > 0 i.e. the handle to pass to other c_shm_ring_...() functions,
+ * or a Scheme integer < 0 i.e. c_errno() on error: -EMFILE if all slots are in use.
+ */
+static ptr c_shm_ring_map(int fd, int rw_mask) {
+  s_shm_ring_local* local;
+  struct stat       st;
+  void*             addr;
+  uint32_t          cap;
+  rw_mask &= mask_READ | mask_WRITE;
+  if (rw_mask == 0) {
+    return Sinteger(c_errno_set(EINVAL));
+  }
+  if (fstat(fd, &st) < 0) {
+    return Sinteger(c_errno());
+  }
+  if (st.st_size < shm_ring_header_size + shm_ring_min_capacity ||
+      st.st_size > shm_ring_header_size + shm_ring_max_capacity) {
+    return Sinteger(c_errno_set(EINVAL));
+  }
+  addr = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    return Sinteger(c_errno());
+  }
+  cap = ((s_shm_ring*)addr)->capacity;
+  if ((off_t)cap + shm_ring_header_size != st.st_size || (cap & (cap - 1)) != 0) {
+    (void)munmap(addr, (size_t)st.st_size);
+    return Sinteger(c_errno_set(EINVAL));
+  }
+  if ((local = calloc(1, sizeof(s_shm_ring_local))) == NULL) {
+    (void)munmap(addr, (size_t)st.st_size);
+    return Sinteger(c_errno_set(ENOMEM));
+  }
+  local->ring    = (s_shm_ring*)addr;
+  local->fd      = fd;
+  local->slot    = -1;
+  local->handoff = -1;
+  local->n_read  = (rw_mask & mask_READ) ? 1 : 0;
+  local->n_write = (rw_mask & mask_WRITE) ? 1 : 0;
+
+  (void)pthread_mutex_lock(&c_shm_ring_mutex);
+  local->slot = c_shm_ring_slot_claim(local, shm_ring_slot_claimed, (uint32_t)rw_mask);
+  if (local->slot >= 0) {
+    local->next     = c_shm_ring_list;
+    c_shm_ring_list = local;
+  }
+  (void)pthread_mutex_unlock(&c_shm_ring_mutex);
+
+  if (local->slot < 0) {
+    (void)munmap(addr, (size_t)st.st_size);
+    free(local);
+    return Sinteger(c_errno_set(EMFILE));
+  }
+  return Sunsigned((uptr)local);
+}
+
+/**
+ * close for one channel of current process the side(s) of a shared-memory ring
+ * indicated by rw_mask, i.e. mask_READ for the consumer and mask_WRITE for the producer.
+ * When no live process holds open a side anymore, mark it as closed and wake up the other side.
+ * When current process no longer holds open either side, unmap the ring and close its file descriptor:
+ * handle becomes invalid.
+ */
+static void c_shm_ring_close(uptr handle, int rw_mask) {
+  s_shm_ring_local*  local = (s_shm_ring_local*)handle;
+  s_shm_ring_local** pp;
+  uint32_t           mask;
+  if (local == NULL) {
+    return;
+  }
+  (void)pthread_mutex_lock(&c_shm_ring_mutex);
+  if ((rw_mask & mask_READ) && local->n_read != 0) {
+    local->n_read--;
+  }
+  if ((rw_mask & mask_WRITE) && local->n_write != 0) {
+    local->n_write--;
+  }
+  mask = c_shm_ring_local_mask(local);
+  if (local->slot >= 0) {
+    atomic_store(&local->ring->slots[local->slot].rw_mask, mask);
+  }
+  if (rw_mask & mask_READ) {
+    c_shm_ring_check_side(local, mask_READ);
+  }
+  if (rw_mask & mask_WRITE) {
+    c_shm_ring_check_side(local, mask_WRITE);
+  }
+  if (mask == 0) {
+    for (pp = &c_shm_ring_list; *pp != NULL; pp = &(*pp)->next) {
+      if (*pp == local) {
+        *pp = local->next;
+        break;
+      }
+    }
+    if (local->slot >= 0) {
+      atomic_store(&local->ring->slots[local->slot].state, shm_ring_slot_free);
+    }
+    (void)munmap(local->ring, shm_ring_header_size + (size_t)local->ring->capacity);
+    (void)close(local->fd); /* also releases the lock of slot */
+    free(local);
+  }
+  (void)pthread_mutex_unlock(&c_shm_ring_mutex);
+}
+
+/**
+ * called by c_fork_pid() immediately before fork():
+ * for each shared-memory ring mapped by current process, reserve a slot for the child,
+ * holding open the same sides as current process.
+ * Leaves c_shm_ring_mutex locked, c_shm_ring_fork_done() unlocks it.
+ */
+static void c_shm_ring_fork_prepare(void) {
+  s_shm_ring_local* local;
+  (void)pthread_mutex_lock(&c_shm_ring_mutex);
+  for (local = c_shm_ring_list; local != NULL; local = local->next) {
+    local->handoff =
+        local->slot < 0 ? -1 :
+                          c_shm_ring_slot_claim(local, shm_ring_slot_handoff, c_shm_ring_local_mask(local));
+  }
+}
+
+/**
+ * called by c_fork_pid() immediately after fork(), with the value it returned.
+ * In the child, claim the slots reserved by c_shm_ring_fork_prepare():
+ * locks are not inherited, and the child holds open the same sides as its parent.
+ * In the parent, release such slots if fork() failed, otherwise they now belong to the child.
+ */
+static void c_shm_ring_fork_done(int pid) {
+  s_shm_ring_local* local;
+  for (local = c_shm_ring_list; local != NULL; local = local->next) {
+    s_shm_ring_slot* s;
+    uint32_t         state = shm_ring_slot_handoff;
+    int              slot  = local->handoff;
+    local->handoff         = -1;
+    if (slot < 0) {
+      if (pid == 0) {
+        local->slot = -1; /* child could not get a slot: its sides will not be seen by other processes */
+      }
+      continue;
+    }
+    s = &local->ring->slots[slot];
+    if (pid == 0) {
+      int err = c_shm_ring_slot_lock(local->fd, slot, F_WRLCK);
+      if (err != -EAGAIN && err != -EACCES &&
+          atomic_compare_exchange_strong(&s->state, &state, shm_ring_slot_claimed)) {
+        local->slot = slot;
+      } else {
+        /* parent died and another process took over the reserved slot */
+        (void)c_shm_ring_slot_lock(local->fd, slot, F_UNLCK);
+        local->slot = -1;
+      }
+    } else if (pid < 0) {
+      atomic_store(&s->rw_mask, 0);
+      atomic_store(&s->state, shm_ring_slot_free);
+    }
+  }
+  (void)pthread_mutex_unlock(&c_shm_ring_mutex);
+}
+
+/**
+ * copy as many bytes as possible from bytevector range [start, end) into a shared-memory ring.
+ * Does not block.
+ * return the number of bytes copied, which is 0 if ring is full,
+ * or c_errno() on error: -EPIPE if consumer closed the ring.
+ */
+static iptr c_shm_ring_write(uptr handle, ptr bvec, iptr start, iptr end) {
+  s_shm_ring* ring = handle ? ((s_shm_ring_local*)handle)->ring : NULL;
+  uint32_t    head, tail, mask, pos, n, first;
+  if (ring == NULL || !Sbytevectorp(bvec) || start < 0 || start > end ||
+      end > Sbytevector_length(bvec)) {
+    return c_errno_set(EINVAL);
+  }
+  if (atomic_load(&ring->closed) & mask_READ) {
+    return c_errno_set(EPIPE);
+  }
+  head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  mask = ring->capacity - 1;
+  n    = ring->capacity - (head - tail);
+  if ((uptr)(end - start) < n) {
+    n = (uint32_t)(end - start);
+  }
+  if (n == 0) {
+    return 0;
+  }
+  pos   = head & mask;
+  first = ring->capacity - pos < n ? ring->capacity - pos : n;
+  memcpy(c_shm_ring_data(ring) + pos, Sbytevector_data(bvec) + start, first);
+  memcpy(c_shm_ring_data(ring), Sbytevector_data(bvec) + start + first, n - first);
+  atomic_store(&ring->head, head + n);
+  if (atomic_load(&ring->readers_waiting) != 0) {
+    c_shm_ring_futex_wake(&ring->read_seq);
+  }
+  return (iptr)n;
+}
+
+/**
+ * copy as many bytes as possible from a shared-memory ring into bytevector range [start, end).
+ * Does not block.
+ * return the number of bytes copied, which is 0 if ring is empty,
+ * or c_errno() on error: -EPIPE if ring is empty and producer closed it i.e. end-of-file.
+ */
+static iptr c_shm_ring_read(uptr handle, ptr bvec, iptr start, iptr end) {
+  s_shm_ring* ring = handle ? ((s_shm_ring_local*)handle)->ring : NULL;
+  uint32_t    head, tail, mask, pos, n, first;
+  int         closed;
+  if (ring == NULL || !Sbytevectorp(bvec) || start < 0 || start > end ||
+      end > Sbytevector_length(bvec)) {
+    return c_errno_set(EINVAL);
+  }
+  /* load closed before head: if producer closed after writing, we see all it wrote */
+  closed = atomic_load(&ring->closed) & mask_WRITE;
+  head   = atomic_load_explicit(&ring->head, memory_order_acquire);
+  tail   = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  mask   = ring->capacity - 1;
+  n      = head - tail;
+  if (n == 0) {
+    return closed ? c_errno_set(EPIPE) : 0;
+  }
+  if ((uptr)(end - start) < n) {
+    n = (uint32_t)(end - start);
+  }
+  pos   = tail & mask;
+  first = ring->capacity - pos < n ? ring->capacity - pos : n;
+  memcpy(Sbytevector_data(bvec) + start, c_shm_ring_data(ring) + pos, first);
+  memcpy(Sbytevector_data(bvec) + start + first, c_shm_ring_data(ring), n - first);
+  atomic_store(&ring->tail, tail + n);
+  if (atomic_load(&ring->writers_waiting) != 0) {
+    c_shm_ring_futex_wake(&ring->write_seq);
+  }
+  return (iptr)n;
+}
+
+/**
+ * wait up to timeout_milliseconds until a shared-memory ring is not empty (if rw_mask == mask_READ)
+ * or not full (if rw_mask == mask_WRITE), or the other side closed it.
+ * timeout_milliseconds < 0 means infinite timeout. Spurious wakeups are allowed.
+ * If timeout_milliseconds >= 0 and the ring is still not ready after waiting,
+ * also check whether some live process still holds open the other side.
+ *
+ * Does not access Scheme objects, thus it can be called as __collect_safe.
+ * return 0 on wakeup or timeout, or c_errno() on error. Does NOT retry on EINTR, returns it instead.
+ */
+static int c_shm_ring_wait(uptr handle, int rw_mask, int timeout_milliseconds) {
+  s_shm_ring_local* local = (s_shm_ring_local*)handle;
+  s_shm_ring*       ring;
+  ATOMIC uint32_t*  seq;
+  ATOMIC uint32_t*  waiting;
+  uint32_t          seq_val;
+  int               ready;
+  int               err = 0;
+  if (local == NULL || (rw_mask != mask_READ && rw_mask != mask_WRITE)) {
+    return c_errno_set(EINVAL);
+  }
+  ring    = local->ring;
+  seq     = rw_mask == mask_READ ? &ring->read_seq : &ring->write_seq;
+  waiting = rw_mask == mask_READ ? &ring->readers_waiting : &ring->writers_waiting;
+
+  /*
+   * the other side stores head or tail, then loads *waiting and changes *seq if needed.
+   * we do the opposite: increment *waiting, load *seq, then load head and tail.
+   * Thus either we see the new head or tail, or futex_wait() sees a different *seq: no wakeup is lost.
+   */
+  atomic_fetch_add(waiting, 1);
+  seq_val = atomic_load(seq);
+  if (rw_mask == mask_READ) {
+    ready = atomic_load(&ring->head) != atomic_load(&ring->tail);
+  } else {
+    ready = atomic_load(&ring->head) - atomic_load(&ring->tail) < ring->capacity;
+  }
+  if (!ready && atomic_load(&ring->closed) == 0) {
+    err = c_shm_ring_futex_wait(seq, seq_val, timeout_milliseconds);
+    if (err == 0 && timeout_milliseconds >= 0 && atomic_load(seq) == seq_val) {
+      c_shm_ring_check_side(local, rw_mask == mask_READ ? mask_WRITE : mask_READ);
+    }
+  }
+  atomic_fetch_sub(waiting, 1);
+  return err;
+}
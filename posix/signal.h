@@ -102,6 +102,21 @@ static int c_signals_setdefault(void) {
   return 0;
 }
 
+#ifdef SCHEMESH_USE_POSIX_SPAWN
+/**
+ * fill sigset with the signals that c_signals_setdefault() would reset to SIG_DFL.
+ * used by posix_spawn() attribute POSIX_SPAWN_SETSIGDEF
+ */
+static void c_signals_fill_setdefault(sigset_t* sigset) {
+  size_t i = 0;
+  sigemptyset(sigset);
+  /* keep current SIGCHLD handler, as c_signals_setdefault() does */
+  for (i = 1; i < N_OF(signals_tohandle); i++) {
+    sigaddset(sigset, signals_tohandle[i]);
+  }
+}
+#endif /* SCHEMESH_USE_POSIX_SPAWN */
+
 static int c_signal_setdefault(int sig) {
   struct sigaction action = {};
   action.sa_handler       = SIG_DFL;
@@ -17,6 +17,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h> /* stat() */
 #include <unistd.h>
 
 #ifndef CHEZ_SCHEME_DIR
@@ -124,12 +125,9 @@ void schemesh_import_all_libraries(void) {
   schemesh_eval("(import (schemesh))\n");
 }
 
-void schemesh_init(const char* override_boot_dir, void (*on_scheme_exception)(void)) {
+static void register_chez_boot_files(const char* override_boot_dir) {
   int loaded = 0;
 
-  c_cleanup_signals();
-
-  Sscheme_init(on_scheme_exception);
   if (override_boot_dir != NULL) {
     size_t dir_len   = strlen(override_boot_dir);
     char*  boot_file = (char*)malloc(dir_len + 13);
@@ -147,5 +145,137 @@ void schemesh_init(const char* override_boot_dir, void (*on_scheme_exception)(vo
     Sregister_boot_file(CHEZ_SCHEME_DIR_STR "/petite.boot");
     Sregister_boot_file(CHEZ_SCHEME_DIR_STR "/scheme.boot");
   }
+}
+
+void schemesh_init(const char* override_boot_dir, void (*on_scheme_exception)(void)) {
+  c_cleanup_signals();
+
+  Sscheme_init(on_scheme_exception);
+  register_chez_boot_files(override_boot_dir);
   Sbuild_heap(NULL, NULL);
 }
+
+/** return malloc()ated string dir + "/" + name, or NULL if out of memory */
+static char* path_join(const char* dir, const char* name) {
+  size_t dir_len  = strlen(dir);
+  size_t name_len = strlen(name);
+  char*  path     = (char*)malloc(dir_len + name_len + 2);
+  if (path != NULL) {
+    memcpy(path, dir, dir_len);
+    path[dir_len] = '/';
+    memcpy(path + dir_len + 1, name, name_len + 1);
+  }
+  return path;
+}
+
+/**
+ * read the header of a Chez Scheme boot file into buf, i.e. its initial bytes
+ * containing "chez", version and machine type, up to the list of boot files it depends on.
+ * return header length, or 0 on error
+ */
+static size_t read_boot_header(const char* path, char* buf, size_t buf_size) {
+  FILE*  f = fopen(path, "rb");
+  size_t n = 0, i;
+  if (f != NULL) {
+    n = fread(buf, 1, buf_size, f);
+    fclose(f);
+  }
+  for (i = 8; i < n; i++) {
+    if (buf[i] == '(') {
+      return memcmp(buf + 4, "chez", 4) == 0 ? i : 0;
+    }
+  }
+  return 0;
+}
+
+/**
+ * return 1 if boot file at path was created by the same Chez Scheme version and machine type
+ * as chez_boot_file, otherwise return 0.
+ * Chez Scheme aborts if a boot file is incompatible, thus we must check it before loading it.
+ */
+static int boot_header_matches(const char* path, const char* chez_boot_file) {
+  char   header[64], chez_header[64];
+  size_t len      = read_boot_header(path, header, sizeof(header));
+  size_t chez_len = read_boot_header(chez_boot_file, chez_header, sizeof(chez_header));
+  return len != 0 && len == chez_len && memcmp(header, chez_header, len) == 0;
+}
+
+/**
+ * search LIBSCHEMESH_SO inside dir. If not found, return 0.
+ *
+ * Otherwise return 1 and set *ret_boot to the malloc()ated path of LIBSCHEMESH_BOOT inside the same dir,
+ * if such file exists, is readable, is not older than LIBSCHEMESH_SO and is compatible with chez_boot_file.
+ * If any of these checks fails, set *ret_boot = NULL because LIBSCHEMESH_SO must be loaded instead.
+ */
+static int find_libschemesh_boot(const char* dir, const char* chez_boot_file, char** ret_boot) {
+  struct stat so_st, boot_st;
+  char*       so_path = path_join(dir, LIBSCHEMESH_SO);
+  char*       path    = NULL;
+  int         found   = 0;
+
+  *ret_boot = NULL;
+  if (so_path != NULL && stat(so_path, &so_st) == 0) {
+    found = 1;
+    path  = path_join(dir, LIBSCHEMESH_BOOT);
+    if (path != NULL && stat(path, &boot_st) == 0 && boot_st.st_mtime >= so_st.st_mtime &&
+        access(path, R_OK) == 0 && boot_header_matches(path, chez_boot_file)) {
+      *ret_boot = path;
+      path      = NULL;
+    }
+  }
+  free(path);
+  free(so_path);
+  return found;
+}
+
+static int register_c_functions_err = 0;
+
+/* called by Sbuild_heap() before running boot files */
+static void register_c_functions_before_boot(void) {
+  register_c_functions_err = schemesh_register_c_functions();
+}
+
+int schemesh_init_with_libraries(const char* override_boot_dir,
+                                 const char* override_library_dir,
+                                 void (*on_scheme_exception)(void)) {
+  char* chez_boot_file = path_join(override_boot_dir != NULL ? override_boot_dir : CHEZ_SCHEME_DIR_STR,
+                                   "petite.boot");
+  char* boot           = NULL;
+
+  if (chez_boot_file != NULL) {
+    /* only look for LIBSCHEMESH_BOOT in the same directory schemesh_load_libraries() would load from */
+    if (override_library_dir != NULL) {
+      (void)find_libschemesh_boot(override_library_dir, chez_boot_file, &boot);
+    } else {
+      int found = 0;
+#ifdef SCHEMESH_DIR_STR
+      found = find_libschemesh_boot(SCHEMESH_DIR_STR, chez_boot_file, &boot);
+#endif
+      if (!found) {
+        found = find_libschemesh_boot("/usr/local/lib/schemesh", chez_boot_file, &boot);
+      }
+      if (!found) {
+        (void)find_libschemesh_boot("/usr/lib/schemesh", chez_boot_file, &boot);
+      }
+    }
+    free(chez_boot_file);
+  }
+  if (boot == NULL) {
+    schemesh_init(override_boot_dir, on_scheme_exception);
+    return 0;
+  }
+
+  c_cleanup_signals();
+
+  Sscheme_init(on_scheme_exception);
+  register_chez_boot_files(override_boot_dir);
+  Sregister_boot_file(boot);
+  free(boot);
+  Sbuild_heap(NULL, &register_c_functions_before_boot);
+
+  if (register_c_functions_err < 0) {
+    return register_c_functions_err;
+  }
+  /* if boot file did not define schemesh libraries, caller must load them normally */
+  return schemesh_eval("(and (member '(schemesh) (library-list)) #t)") == Strue ? 1 : 0;
+}
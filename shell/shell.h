@@ -11,6 +11,7 @@
 #define SCHEMESH_SHELL_SHELL_H
 
 #define LIBSCHEMESH_SO "libschemesh_0.9.1.so"
+#define LIBSCHEMESH_BOOT "schemesh_0.9.1.boot"
 
 /**
  * initialize Chez Scheme.
@@ -29,6 +30,33 @@
  */
 void schemesh_init(const char* override_boot_dir, void (*on_scheme_exception)(void));
 
+/**
+ * initialize Chez Scheme and, if possible, also load schemesh libraries from a boot file.
+ *
+ * LIBSCHEMESH_BOOT is searched only in the directory schemesh_load_libraries() would load
+ * LIBSCHEMESH_SO from, i.e. override_library_dir if set, otherwise the first system-wide
+ * installation directory containing LIBSCHEMESH_SO.
+ * It is ignored if older than LIBSCHEMESH_SO, or if created by a different Chez Scheme version
+ * or machine type.
+ *
+ * if a usable LIBSCHEMESH_BOOT is found, calls in sequence:
+ *   Sscheme_init(on_scheme_exception);
+ *   Sregister_boot_file() for petite.boot, scheme.boot and LIBSCHEMESH_BOOT;
+ *   Sbuild_heap(NULL, custom_init);
+ * where custom_init calls schemesh_register_c_functions() before the boot files are run,
+ * so that schemesh libraries are already loaded when Sbuild_heap() returns.
+ *
+ * otherwise, it is equivalent to schemesh_init(override_boot_dir, on_scheme_exception)
+ *
+ * return 1 if schemesh libraries were loaded from LIBSCHEMESH_BOOT,
+ * return 0 if LIBSCHEMESH_BOOT was not found or does not define schemesh libraries: caller must then call
+ *   schemesh_register_c_functions() and schemesh_load_libraries()
+ * return < 0 if registering C functions failed.
+ */
+int schemesh_init_with_libraries(const char* override_boot_dir,
+                                 const char* override_library_dir,
+                                 void (*on_scheme_exception)(void));
+
 /** register all C functions needed by schemesh libraries. return != 0 if failed */
 int schemesh_register_c_functions(void);
 
@@ -0,0 +1,127 @@
+/**
+ * Copyright (C) 2023-2025 by Massimiliano Ghilardi
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+/**
+ * micro-benchmark for UTF-8b conversions in containers/containers.c
+ *
+ * includes containers/containers.c to access its static functions.
+ * "make bench_utf8b" compiles it twice, with and without -DSCHEMESH_NO_SIMD,
+ * and runs both executables to compare the vectorized fast paths with the scalar loops.
+ */
+
+#include "../containers/containers.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h> /* clock_gettime() */
+
+#ifndef CHEZ_SCHEME_DIR
+#error "please #define CHEZ_SCHEME_DIR to the installation path of Chez Scheme"
+#endif
+
+#define STR_(arg) #arg
+#define STR(arg) STR_(arg)
+#define CHEZ_SCHEME_DIR_STR STR(CHEZ_SCHEME_DIR)
+
+enum { input_len = 16 << 20, run_n = 8 };
+
+static double now_seconds(void) {
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec + 1e-9 * (double)t.tv_nsec;
+}
+
+/**
+ * fill input[] with lines of text.
+ * if multibyte_percent > 0, about that percentage of characters are two- or three-byte UTF-8
+ * sequences, and a few bytes are invalid UTF-8 that UTF-8b converts to surrogates.
+ */
+static void fill_input(octet* input, size_t len, unsigned multibyte_percent) {
+  size_t   i    = 0;
+  unsigned seed = 12345;
+  while (i < len) {
+    seed = seed * 1103515245u + 12345u;
+    if (i % 80 == 79) {
+      input[i++] = '\n';
+    } else if ((seed >> 16) % 100 < multibyte_percent && i + 3 <= len) {
+      if ((seed >> 8) & 1) {
+        input[i++] = 0xC3; /* U+00E0 ... U+00FF */
+        input[i++] = 0xA0 | ((seed >> 4) & 0x1F);
+      } else {
+        input[i++] = 0xE2; /* U+2080 ... U+20BF */
+        input[i++] = 0x82;
+        input[i++] = 0x80 | ((seed >> 4) & 0x3F);
+      }
+    } else if ((seed >> 16) % 1000 == 999) {
+      input[i++] = 0xFF; /* invalid UTF-8 */
+    } else {
+      input[i++] = 'a' + (seed >> 16) % 26;
+    }
+  }
+}
+
+static void benchmark(const char* label, unsigned multibyte_percent) {
+  octet* input = malloc(input_len);
+  ptr    str;
+  double start, decode_sec, encode_sec;
+  int    i;
+  if (input == NULL) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  fill_input(input, input_len, multibyte_percent);
+  str = Sfalse;
+
+  start = now_seconds();
+  for (i = 0; i < run_n; i++) {
+    str = schemesh_Sstring_utf8b((const char*)input, input_len);
+  }
+  decode_sec = (now_seconds() - start) / run_n;
+
+  Slock_object(str);
+  {
+    ptr bvec = Smake_bytevector(input_len, 0);
+    ptr ret  = Sfalse;
+    start    = now_seconds();
+    for (i = 0; i < run_n; i++) {
+      ret = c_string_to_utf8b_append(str, 0, Sstring_length(str), bvec, 0);
+    }
+    encode_sec = (now_seconds() - start) / run_n;
+    if (ret != Sfixnum(input_len) || memcmp(Sbytevector_data(bvec), input, input_len) != 0) {
+      fprintf(stderr, "%s: UTF-8b roundtrip failed\n", label);
+      exit(1);
+    }
+  }
+  Sunlock_object(str);
+
+  fprintf(stdout,
+          "%-8s %-20s decode %8.1f MB/s\tencode %8.1f MB/s\n",
+#ifdef SCHEMESH_NO_SIMD
+          "scalar",
+#else
+          "simd",
+#endif
+          label,
+          input_len / decode_sec * 1e-6,
+          input_len / encode_sec * 1e-6);
+  free(input);
+}
+
+int main(void) {
+  Sscheme_init(NULL);
+  Sregister_boot_file(CHEZ_SCHEME_DIR_STR "/petite.boot");
+  Sbuild_heap(NULL, NULL);
+
+  benchmark("ascii", 0);
+  benchmark("mostly-ascii", 2);
+  benchmark("multibyte-heavy", 40);
+
+  Sscheme_deinit();
+  return 0;
+}